@@ -0,0 +1,112 @@
+// Copyright (C) 2024 Ethan Uppal. All rights reserved.
+//
+// Measures how ca_parse_batch() scales with the number of threads.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <cmdapp.h>
+
+#define ITEMS 200000
+#define REPEATS 3
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, const char* argv[]) {
+    struct ca_app* ctx = ca_ctx_new(argc, argv);
+    if (!ctx) {
+        perror("ca_ctx_new");
+        return 1;
+    }
+    const char* arg = NULL;
+    ca_ctx_opt(ctx, 'j', "jobs", ".N", &arg, "number of jobs");
+    ca_ctx_opt(ctx, 'o', "output", ".FILE", &arg, "output file");
+    ca_ctx_opt(ctx, 'v', "verbose", "*", NULL, "verbose");
+    ca_ctx_opt(ctx, 'q', "quiet", "* !@v", NULL, "quiet");
+    ca_ctx_opt(ctx, 'x', "extra", "* &v", NULL, "extra");
+    const struct ca_schema* schema = ca_ctx_schema(ctx);
+    if (!schema) {
+        perror("ca_ctx_schema");
+        return 1;
+    }
+
+    // mostly short command lines, with every 1000th one very long, so that
+    // an even split would leave some threads waiting on others
+    static const char* line[] = {"prog", "-j", "8", "--output", "out.txt",
+        "-vx", "in.c"};
+    const int line_length = sizeof(line) / sizeof(*line);
+    const int long_length = 20000;
+    const char** long_line = malloc(sizeof(*long_line) * long_length);
+    struct ca_batch_item* items = malloc(sizeof(*items) * ITEMS);
+    enum ca_error* results = malloc(sizeof(*results) * ITEMS);
+    if (!long_line || !items || !results) {
+        perror("malloc");
+        return 1;
+    }
+    long_line[0] = "prog";
+    for (int i = 1; i < long_length; i++) {
+        long_line[i] = i % 2 ? "-v" : "file.c";
+    }
+    long args = 0;
+    for (size_t i = 0; i < ITEMS; i++) {
+        if (i % 1000 == 999) {
+            items[i].argc = long_length;
+            items[i].argv = long_line;
+        } else {
+            items[i].argc = line_length;
+            items[i].argv = line;
+        }
+        args += items[i].argc - 1;
+    }
+
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (processors < 1) {
+        processors = 1;
+    }
+
+    printf("# ca_parse_batch: %d items, %ld args\n", ITEMS, args);
+    printf("%-8s %12s %10s %8s\n", "threads", "seconds", "ns/arg", "speedup");
+    double base = 0;
+    for (long threads = 1; threads <= processors; threads *= 2) {
+        double best = 0;
+        for (int r = 0; r < REPEATS; r++) {
+            double start = now();
+            if (ca_parse_batch(schema, items, ITEMS, results, threads) != 0) {
+                perror("ca_parse_batch");
+                return 1;
+            }
+            double elapsed = now() - start;
+            if (r == 0 || elapsed < best) {
+                best = elapsed;
+            }
+        }
+        if (threads == 1) {
+            base = best;
+        }
+        printf("%-8ld %12.6f %10.2f %8.2f\n", threads, best, best * 1e9 / args,
+            base / best);
+        if (threads < processors && threads * 2 > processors) {
+            threads = processors / 2;
+        }
+    }
+
+    for (size_t i = 0; i < ITEMS; i++) {
+        if (results[i] != CA_ERROR_NONE) {
+            fprintf(stderr, "item %zu failed with error %d\n", i, results[i]);
+            return 1;
+        }
+    }
+
+    free(results);
+    free(items);
+    free(long_line);
+    ca_ctx_free(ctx);
+    return 0;
+}
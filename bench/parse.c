@@ -0,0 +1,232 @@
+// Copyright (C) 2024 Ethan Uppal. All rights reserved.
+//
+// Measures the cost of a whole parse, from creating a context and registering
+// its options through ca_ctx_parse(), over synthetic schemas and command
+// lines. Pass --json for one JSON object per measurement instead of a table.
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <cmdapp.h>
+
+/** Each measurement parses at least this many arguments in total. */
+#define MIN_TOTAL_ARGS 2000000L
+#define MIN_REPEATS 3
+
+/** The most options a schema has. */
+#define MAX_OPTIONS 1024
+
+/** The kinds of command line measured. */
+enum kind {
+    KIND_SHORT,      ///< Clusters of short multiflags.
+    KIND_LONG,       ///< Long options with attached arguments.
+    KIND_CONSTRAINT  ///< Short flags whose behaviors refer to others.
+};
+
+static const char* kind_names[] = {"short", "long", "constraint"};
+
+/** Every character that can be a short option. */
+static const char shorts[]
+    = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+#define SHORT_COUNT ((int)sizeof(shorts) - 1)
+
+static char long_names[MAX_OPTIONS][24];
+static char behaviors[MAX_OPTIONS][16];
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** Allocations made through the library since the last reset. */
+static long allocations = 0;
+
+static void* counting_alloc(size_t size, void* user) {
+    allocations++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* ptr, size_t size, void* user) {
+    allocations++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void* ptr, void* user) {
+    free(ptr);
+}
+
+/** Registers the options of a schema of `kind` with `count` options. */
+static int register_options(struct ca_app* ctx, enum kind kind, int count,
+    const char** result) {
+    for (int i = 0; i < count; i++) {
+        char short_opt = i < SHORT_COUNT ? shorts[i] : '\0';
+        int handle;
+        if (kind == KIND_LONG) {
+            handle = ca_ctx_opt(ctx, short_opt, long_names[i], ".V", result,
+                "");
+        } else {
+            handle = ca_ctx_opt(ctx, short_opt, long_names[i], behaviors[i],
+                NULL, "");
+        }
+        if (handle < 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/** The number of options in a schema of `count` that have a short name. */
+static int short_count(int count) {
+    return count < SHORT_COUNT ? count : SHORT_COUNT;
+}
+
+/** Fills `argv` with a command line of `kind` of `argc` - 1 arguments. */
+static void make_argv(const char** argv, int argc, enum kind kind, int count,
+    char (*words)[24]) {
+    // the last two short options are excluded by the constraint kind
+    int shorts_used = short_count(count) - 2;
+    argv[0] = "bench";
+    for (int i = 1; i < argc; i++) {
+        char* word = words[(i - 1) % 4096];
+        argv[i] = word;
+    }
+    for (int i = 0; i < 4096; i++) {
+        char* word = words[i];
+        switch (kind) {
+            case KIND_SHORT:
+            case KIND_CONSTRAINT:
+                // a cluster of four, led by the flag the others may need
+                word[0] = '-';
+                word[1] = shorts[0];
+                for (int j = 0; j < 3; j++) {
+                    word[2 + j] = shorts[1 + (i * 3 + j) % (shorts_used - 1)];
+                }
+                word[5] = '\0';
+                break;
+            case KIND_LONG:
+                snprintf(word, 24, "--%s=%d", long_names[i % count], i);
+                break;
+        }
+    }
+}
+
+/** Names the options of a schema of `kind` and sets their behaviors. */
+static void make_behaviors(enum kind kind, int count) {
+    int last = short_count(count) - 1;
+    for (int i = 0; i < count; i++) {
+        snprintf(long_names[i], sizeof(long_names[i]), "option-%d", i);
+        if (kind == KIND_CONSTRAINT && i > 0 && i < last - 1) {
+            // a behavior has one quantifier, so these alternate between
+            // needing the first flag and excluding the last two, which are
+            // never passed
+            if (i % 2) {
+                snprintf(behaviors[i], sizeof(behaviors[i]), "* &%c",
+                    shorts[0]);
+            } else {
+                snprintf(behaviors[i], sizeof(behaviors[i]), "* !@%c%c",
+                    shorts[last], shorts[last - 1]);
+            }
+        } else {
+            strcpy(behaviors[i], "*");
+        }
+    }
+}
+
+/**
+ * Runs one measurement, setting the time per parse and the allocations per
+ * parse. Returns zero on success.
+ */
+static int measure(enum kind kind, int count, int argc, const char** argv,
+    double* seconds, double* allocs) {
+    long repeats = MIN_TOTAL_ARGS / argc;
+    if (repeats < MIN_REPEATS) {
+        repeats = MIN_REPEATS;
+    }
+
+    allocations = 0;
+    double start = now();
+    for (long r = 0; r < repeats; r++) {
+        struct ca_app* ctx = ca_ctx_new(argc, argv);
+        if (!ctx) {
+            perror("ca_ctx_new");
+            return 1;
+        }
+        const char* result = NULL;
+        if (register_options(ctx, kind, count, &result) != 0) {
+            perror("ca_ctx_opt");
+            return 1;
+        }
+        if (ca_ctx_parse(ctx, NULL) != 0) {
+            fprintf(stderr, "parse of %s command line failed\n",
+                kind_names[kind]);
+            return 1;
+        }
+        ca_ctx_free(ctx);
+    }
+    *seconds = (now() - start) / repeats;
+    *allocs = (double)allocations / repeats;
+    return 0;
+}
+
+int main(int argc, const char* argv[]) {
+    bool json = argc > 1 && strcmp(argv[1], "--json") == 0;
+
+    // contexts created from here on count their allocations
+    struct ca_allocator allocator = {counting_alloc, counting_realloc,
+        counting_free, NULL};
+    ca_set_allocator(&allocator);
+
+    static const int schema_sizes[] = {16, 128, 1024};
+    static const int arg_counts[] = {10, 1000, 100000, 1000000};
+    const int max_args = 1000000;
+    const char** bench_argv = malloc(sizeof(*bench_argv) * (max_args + 1));
+    char (*words)[24] = malloc(sizeof(*words) * 4096);
+    if (!bench_argv || !words) {
+        perror("malloc");
+        return 1;
+    }
+
+    if (!json) {
+        printf("# ca_ctx_new() + registration + ca_ctx_parse()\n");
+        printf("%-8s %-11s %8s %14s %10s %12s\n", "options", "kind", "args",
+            "ns/parse", "ns/arg", "allocs/parse");
+    }
+    for (size_t s = 0; s < sizeof(schema_sizes) / sizeof(*schema_sizes);
+         s++) {
+        for (int k = KIND_SHORT; k <= KIND_CONSTRAINT; k++) {
+            int count = schema_sizes[s];
+            make_behaviors(k, count);
+            make_argv(bench_argv, max_args + 1, k, count, words);
+            for (size_t a = 0; a < sizeof(arg_counts) / sizeof(*arg_counts);
+                 a++) {
+                int args = arg_counts[a];
+                double seconds, allocs;
+                if (measure(k, count, args + 1, bench_argv, &seconds, &allocs)
+                    != 0) {
+                    return 1;
+                }
+                double ns = seconds * 1e9;
+                if (json) {
+                    printf("{\"bench\": \"parse\", \"options\": %d, "
+                           "\"kind\": \"%s\", \"args\": %d, "
+                           "\"ns_per_parse\": %.1f, \"ns_per_arg\": %.3f, "
+                           "\"allocs_per_parse\": %.2f}\n",
+                        count, kind_names[k], args, ns, ns / args, allocs);
+                } else {
+                    printf("%-8d %-11s %8d %14.1f %10.3f %12.2f\n", count,
+                        kind_names[k], args, ns, ns / args, allocs);
+                }
+                fflush(stdout);
+            }
+        }
+    }
+
+    free(words);
+    free(bench_argv);
+    return 0;
+}
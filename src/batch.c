@@ -0,0 +1,220 @@
+/**
+ * \file batch.c
+ * \brief Parsing many command lines at once on a pool of threads.
+ * \copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ * \author Ethan Uppal
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#define CA_PRIVATE_SRC
+#include "cmdapp.h"
+#undef CA_PRIVATE_SRC
+
+#ifdef CA_ON_UNIX
+    #include <pthread.h>
+#endif
+
+/** What every worker in a batch shares. */
+struct ca_batch {
+    const struct ca_batch_item* items;
+    enum ca_error* results;
+    size_t workers_length;
+    struct ca_batch_worker* workers;
+};
+
+/**
+ * A thread parsing part of a batch.
+ *
+ * Each worker owns the range of items `[begin, end)`, which it consumes from
+ * the front. A worker that runs out steals the back half of the range of
+ * another, so a few long command lines hold up only the worker parsing them.
+ */
+struct ca_batch_worker {
+    struct ca_parse_state state;  ///< Reused for every item this parses.
+    struct ca_batch* batch;
+#ifdef CA_ON_UNIX
+    pthread_mutex_t lock;  ///< Guards `begin` and `end`.
+    pthread_t thread;
+    bool started;  ///< Whether `thread` was created.
+#endif
+    size_t begin;
+    size_t end;
+    char padding[64];  ///< Keeps `lock` off the cache lines of neighbors.
+};
+
+/** Parses item `i` of the batch with the state of `worker`. */
+static void ca_batch_parse(struct ca_batch_worker* worker, size_t i) {
+    struct ca_parse_state* state = &worker->state;
+    const struct ca_batch_item* item = &worker->batch->items[i];
+    if (ca_state_reset(state, item->argc, item->argv) == 0
+        && ca_construct_results(state) == 0) {
+        ca_verify_results(state);
+    }
+    worker->batch->results[i] = state->error;
+}
+
+#ifdef CA_ON_UNIX
+
+/** Takes the next item of the range of `worker`, if any, into `*i`. */
+static bool ca_batch_take(struct ca_batch_worker* worker, size_t* i) {
+    pthread_mutex_lock(&worker->lock);
+    bool took = worker->begin < worker->end;
+    if (took) {
+        *i = worker->begin++;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return took;
+}
+
+/**
+ * Steals the back half of the range of some other worker for `worker` and
+ * takes its first item into `*i`. Returns `false` if there is nothing left to
+ * steal.
+ */
+static bool ca_batch_steal(struct ca_batch_worker* worker, size_t* i) {
+    struct ca_batch* batch = worker->batch;
+    size_t self = (size_t)(worker - batch->workers);
+    for (size_t k = 1; k < batch->workers_length; k++) {
+        struct ca_batch_worker* victim =
+            &batch->workers[(self + k) % batch->workers_length];
+
+        pthread_mutex_lock(&victim->lock);
+        size_t begin = victim->begin;
+        size_t end = victim->end;
+        size_t middle = begin + (end - begin) / 2;
+        if (begin < end) {
+            victim->end = middle;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (begin < end) {
+            pthread_mutex_lock(&worker->lock);
+            worker->begin = middle + 1;
+            worker->end = end;
+            pthread_mutex_unlock(&worker->lock);
+            *i = middle;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Runs `worker` until no worker has items left. */
+static void* ca_batch_run(void* data) {
+    struct ca_batch_worker* worker = data;
+    size_t i;
+    while (ca_batch_take(worker, &i) || ca_batch_steal(worker, &i)) {
+        ca_batch_parse(worker, i);
+    }
+    return NULL;
+}
+
+/** Returns the number of online processors, or one if it is unknown. */
+static size_t ca_batch_default_threads(void) {
+    #ifdef _SC_NPROCESSORS_ONLN
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (processors > 0) {
+        return (size_t)processors;
+    }
+    #endif
+    return 1;
+}
+
+#endif
+
+int ca_parse_batch(const struct ca_schema* schema,
+    const struct ca_batch_item* items, size_t count, enum ca_error* results,
+    size_t nthreads) {
+    if (!schema || (count > 0 && (!items || !results))) {
+        errno = EINVAL;
+        return 1;
+    }
+
+#ifdef CA_ON_UNIX
+    if (nthreads == 0) {
+        nthreads = ca_batch_default_threads();
+    }
+#else
+    // without threads the calling thread does all the work
+    nthreads = 1;
+#endif
+    if (nthreads > count) {
+        nthreads = count > 0 ? count : 1;
+    }
+
+    struct ca_batch batch;
+    batch.items = items;
+    batch.results = results;
+    batch.workers_length = 0;
+    struct ca_memory memory;
+    ca_memory_init(&memory, false);
+    batch.workers = ca_memory_alloc(&memory,
+        sizeof(*batch.workers) * nthreads);
+    if (!batch.workers) {
+        errno = ENOMEM;
+        return 1;
+    }
+    memset(batch.workers, 0, sizeof(*batch.workers) * nthreads);
+
+    // split the items evenly to begin with
+    for (size_t w = 0; w < nthreads; w++) {
+        struct ca_batch_worker* worker = &batch.workers[w];
+        if (ca_state_init(&worker->state, schema, NULL) != 0) {
+            ca_state_deinit(&worker->state);
+            break;
+        }
+        worker->state.quiet = true;
+        worker->batch = &batch;
+        worker->begin = count * w / nthreads;
+        worker->end = count * (w + 1) / nthreads;
+#ifdef CA_ON_UNIX
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->started = false;
+#endif
+        batch.workers_length++;
+    }
+    if (batch.workers_length == 0) {
+        ca_memory_free(&memory, batch.workers);
+        errno = ENOMEM;
+        return 1;
+    }
+    // workers that could not be set up leave their items to be stolen
+    if (batch.workers_length < nthreads) {
+        batch.workers[batch.workers_length - 1].end = count;
+    }
+
+#ifdef CA_ON_UNIX
+    // the calling thread is the first worker; a worker whose thread cannot be
+    // created simply has its items stolen
+    for (size_t w = 1; w < batch.workers_length; w++) {
+        struct ca_batch_worker* worker = &batch.workers[w];
+        worker->started = pthread_create(&worker->thread, NULL, ca_batch_run,
+                              worker)
+                          == 0;
+    }
+    ca_batch_run(&batch.workers[0]);
+    for (size_t w = 1; w < batch.workers_length; w++) {
+        if (batch.workers[w].started) {
+            pthread_join(batch.workers[w].thread, NULL);
+        }
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        ca_batch_parse(&batch.workers[0], i);
+    }
+#endif
+
+    for (size_t w = 0; w < batch.workers_length; w++) {
+        ca_state_deinit(&batch.workers[w].state);
+#ifdef CA_ON_UNIX
+        pthread_mutex_destroy(&batch.workers[w].lock);
+#endif
+    }
+    ca_memory_free(&memory, batch.workers);
+
+    return 0;
+}
@@ -0,0 +1,484 @@
+/**
+ * \file blob.c
+ * \brief Saving frozen schemas as flat blobs and loading them back.
+ * \copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ * \author Ethan Uppal
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#define CA_PRIVATE_SRC
+#include "cmdapp.h"
+#undef CA_PRIVATE_SRC
+
+/**
+ * Where a blob is written: into `data` if it is non-`NULL`, which must then
+ * hold the whole blob. Otherwise, the blob is only measured.
+ */
+struct ca_blob_writer {
+    char* data;
+    size_t length;  ///< The length of the blob so far.
+};
+
+/** Pads `writer` with zeros to a multiple of `align` bytes. */
+static void ca_blob_align(struct ca_blob_writer* writer, size_t align) {
+    size_t padding = (align - writer->length % align) % align;
+    if (writer->data) {
+        memset(writer->data + writer->length, 0, padding);
+    }
+    writer->length += padding;
+}
+
+/**
+ * Appends the `size` bytes of `bytes` to `writer` at a multiple of `align`
+ * bytes, or only reserves them if `bytes` is `NULL`. Returns their offset.
+ */
+static uint64_t ca_blob_put(struct ca_blob_writer* writer, const void* bytes,
+    size_t size, size_t align) {
+    ca_blob_align(writer, align);
+    size_t offset = writer->length;
+    if (writer->data && bytes) {
+        memcpy(writer->data + offset, bytes, size);
+    }
+    writer->length += size;
+    return offset;
+}
+
+/** Appends `length` bytes of `str` and a terminator to `writer`. */
+static uint64_t ca_blob_put_string(struct ca_blob_writer* writer,
+    const char* str, size_t length) {
+    uint64_t offset = ca_blob_put(writer, str, length, 1);
+    ca_blob_put(writer, "", 1, 1);
+    return offset;
+}
+
+/** Appends `str` to `writer`. Returns its offset, or zero if it is `NULL`. */
+static uint64_t ca_blob_string(struct ca_blob_writer* writer,
+    const char* str) {
+    return str ? ca_blob_put_string(writer, str, strlen(str)) : 0;
+}
+
+/**
+ * Appends an array of the offsets of the `length` strings of `strs` to
+ * `writer`, followed by the strings. Returns the offset of the array.
+ */
+static uint64_t ca_blob_strings(struct ca_blob_writer* writer,
+    const char* const* strs, size_t length) {
+    uint64_t array = ca_blob_put(writer, NULL, sizeof(uint64_t) * length, 8);
+    for (size_t i = 0; i < length; i++) {
+        uint64_t offset = ca_blob_string(writer, strs[i]);
+        if (writer->data) {
+            memcpy(writer->data + array + sizeof(uint64_t) * i, &offset,
+                sizeof(offset));
+        }
+    }
+    return array;
+}
+
+/**
+ * Appends the text `render` produces for `schema` to `writer`, setting
+ * `*length` to its length. Returns its offset.
+ */
+static uint64_t ca_blob_text(struct ca_blob_writer* writer,
+    const struct ca_schema* schema,
+    void (*render)(const struct ca_schema*, struct ca_text*),
+    uint64_t* length) {
+    struct ca_text text;
+    ca_text_init(&text, NULL, 0, NULL);
+    render(schema, &text);
+    uint64_t offset = ca_blob_put(writer, NULL, text.length, 1);
+    if (writer->data) {
+        ca_text_init(&text, writer->data + offset, text.length, NULL);
+        render(schema, &text);
+    }
+    *length = text.length;
+    return offset;
+}
+
+/** Writes the blob of `schema` to `writer`. */
+static void ca_blob_write(struct ca_blob_writer* writer,
+    const struct ca_schema* schema) {
+    // the header is filled in as the rest is laid out, and copied in last
+    struct ca_blob_header header;
+    memset(&header, 0, sizeof(header));
+    ca_blob_put(writer, NULL, sizeof(header), 8);
+    memcpy(header.magic, CA_BLOB_MAGIC, sizeof(header.magic));
+    header.version = CA_BLOB_VERSION;
+    header.header_size = sizeof(header);
+    header.hot_size = sizeof(struct ca_opt_hot);
+
+    header.program = ca_blob_string(writer, schema->program);
+    header.description = ca_blob_string(writer, schema->description);
+    header.ver_info = ca_blob_string(writer, schema->ver_info);
+    header.env_prefix = ca_blob_string(writer, schema->env_prefix);
+    header.config_path = ca_blob_string(writer, schema->config_path);
+    header.authors = ca_blob_strings(writer, schema->authors,
+        schema->authors_length);
+    header.authors_length = schema->authors_length;
+    header.synopses = ca_blob_strings(writer, schema->synopses,
+        schema->synopses_length);
+    header.synopses_length = schema->synopses_length;
+    header.help_text = ca_blob_text(writer, schema, ca_render_help_text,
+        &header.help_length);
+    header.version_text = ca_blob_text(writer, schema,
+        ca_render_version_text, &header.version_length);
+
+    header.options_length = schema->options_length;
+    header.options = ca_blob_put(writer, NULL,
+        sizeof(struct ca_blob_opt) * schema->options_length, 8);
+    for (size_t i = 0; i < schema->options_length; i++) {
+        const struct ca_opt* opt = &schema->options[i];
+        struct ca_blob_opt saved;
+        memset(&saved, 0, sizeof(saved));
+        saved.long_opt = ca_blob_string(writer, opt->long_opt);
+        if (opt->arg_name) {
+            // the name ends where its part of the behavior string does
+            size_t length = 0;
+            while (isalpha(opt->arg_name[length])) {
+                length++;
+            }
+            saved.arg_name = ca_blob_put_string(writer, opt->arg_name,
+                length);
+        }
+        saved.description = ca_blob_string(writer, opt->description);
+        saved.type = opt->type;
+        if (writer->data) {
+            memcpy(writer->data + header.options + sizeof(saved) * i, &saved,
+                sizeof(saved));
+        }
+    }
+    // copied field by field, so that the padding is always zero
+    header.hot = ca_blob_put(writer, NULL,
+        sizeof(*schema->hot) * schema->options_length, 8);
+    for (size_t i = 0; writer->data && i < schema->options_length; i++) {
+        const struct ca_opt_hot* hot = &schema->hot[i];
+        struct ca_opt_hot saved;
+        memset(&saved, 0, sizeof(saved));
+        saved.refs_mask = hot->refs_mask;
+        saved.flags = hot->flags;
+        saved.quantifier = hot->quantifier;
+        saved.quantifier_is_negated = hot->quantifier_is_negated;
+        saved.short_opt = hot->short_opt;
+        memcpy(writer->data + header.hot + sizeof(saved) * i, &saved,
+            sizeof(saved));
+    }
+
+    header.long_opts = ca_blob_put(writer, schema->long_opts,
+        sizeof(*schema->long_opts) * schema->long_opts_capacity, 8);
+    header.long_opts_capacity = schema->long_opts_capacity;
+    header.short_opts_mask = schema->short_opts_mask;
+    header.mflag_mask = schema->mflag_mask;
+    for (size_t i = 0; i < CA_SHORT_OPT_COUNT; i++) {
+        header.short_opts[i] = schema->short_opts[i];
+    }
+
+    header.year = schema->year;
+    header.ver_major = schema->ver_major;
+    header.ver_minor = schema->ver_minor;
+    header.ver_patch = schema->ver_patch;
+    header.use_end_of_options = schema->use_end_of_options;
+    header.use_response_files = schema->use_response_files;
+    header.use_man_option = schema->use_man_option;
+    header.use_complete_option = schema->use_complete_option;
+    header.override_help = schema->override_help;
+    header.override_version = schema->override_version;
+
+    ca_blob_align(writer, 8);
+    header.size = writer->length;
+    if (writer->data) {
+        memcpy(writer->data, &header, sizeof(header));
+    }
+}
+
+size_t ca_schema_serialize(const struct ca_schema* schema, void* buffer,
+    size_t capacity) {
+    if (!schema || !schema->frozen || (!buffer && capacity > 0)) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    // measure first, so that nothing is written unless all of it fits
+    struct ca_blob_writer writer = {NULL, 0};
+    ca_blob_write(&writer, schema);
+    size_t size = writer.length;
+    if (size <= capacity) {
+        writer.data = buffer;
+        writer.length = 0;
+        ca_blob_write(&writer, schema);
+    }
+    return size;
+}
+
+/**
+ * Whether `count` elements of `elem_size` bytes at `offset` lie within the
+ * blob of `header`, aligned to `align` bytes.
+ */
+static bool ca_blob_has(const struct ca_blob_header* header, uint64_t offset,
+    uint64_t count, size_t elem_size, size_t align) {
+    return offset % align == 0 && offset >= sizeof(*header)
+           && offset <= header->size
+           && count <= (header->size - offset) / elem_size;
+}
+
+/**
+ * Points `*str` at the string at `offset` in the blob of `header`, or at
+ * `NULL` if `offset` is zero. Returns whether the string is well formed.
+ */
+static bool ca_blob_get_string(const struct ca_blob_header* header,
+    uint64_t offset, const char** str) {
+    const char* base = (const char*)header;
+    if (offset == 0) {
+        *str = NULL;
+        return true;
+    }
+    if (!ca_blob_has(header, offset, 1, 1, 1)
+        || !memchr(base + offset, '\0', header->size - offset)) {
+        return false;
+    }
+    *str = base + offset;
+    return true;
+}
+
+/**
+ * Points the `count` entries of `strs` at the strings whose offsets are in
+ * the array at `offset` in the blob of `header`. Returns whether they are all
+ * well formed.
+ */
+static bool ca_blob_get_strings(const struct ca_blob_header* header,
+    uint64_t offset, uint64_t count, const char** strs) {
+    const char* base = (const char*)header;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t str;
+        memcpy(&str, base + offset + sizeof(str) * i, sizeof(str));
+        if (!ca_blob_get_string(header, str, &strs[i]) || !strs[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Whether `c` is a character that can be a short option. */
+static bool ca_blob_is_short_opt(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+           || (c >= '0' && c <= '9');
+}
+
+/** Whether `index` is `CA_NO_OPT` or names one of `length` options. */
+static bool ca_blob_is_opt(int index, uint64_t length) {
+    return index == CA_NO_OPT || (index >= 0 && (uint64_t)index < length);
+}
+
+/**
+ * Whether the parts of the blob of `header`, which is `size` bytes long, that
+ * are used in place are well formed.
+ */
+static bool ca_blob_check(const struct ca_blob_header* header, size_t size) {
+    if (size < sizeof(*header) || (uintptr_t)header % 8 != 0
+        || memcmp(header->magic, CA_BLOB_MAGIC, sizeof(header->magic)) != 0
+        || header->version != CA_BLOB_VERSION
+        || header->header_size != sizeof(*header)
+        || header->hot_size != sizeof(struct ca_opt_hot)
+        || header->size > size) {
+        return false;
+    }
+    uint64_t length = header->options_length;
+    if (!ca_blob_has(header, header->authors, header->authors_length,
+            sizeof(uint64_t), 8)
+        || !ca_blob_has(header, header->synopses, header->synopses_length,
+            sizeof(uint64_t), 8)
+        || !ca_blob_has(header, header->help_text, header->help_length, 1, 1)
+        || !ca_blob_has(header, header->version_text, header->version_length,
+            1, 1)
+        || !ca_blob_has(header, header->options, length,
+            sizeof(struct ca_blob_opt), 8)
+        || !ca_blob_has(header, header->hot, length,
+            sizeof(struct ca_opt_hot), 8)
+        || length > INT32_MAX) {
+        return false;
+    }
+
+    // lookups probe until an empty slot, so there must be one
+    uint64_t capacity = header->long_opts_capacity;
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0
+        || capacity <= length
+        || !ca_blob_has(header, header->long_opts, capacity, sizeof(int),
+            8)) {
+        return false;
+    }
+    const int* long_opts
+        = (const int*)((const char*)header + header->long_opts);
+    for (uint64_t i = 0; i < capacity; i++) {
+        if (!ca_blob_is_opt(long_opts[i], length)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < CA_SHORT_OPT_COUNT; i++) {
+        if (!ca_blob_is_opt(header->short_opts[i], length)) {
+            return false;
+        }
+    }
+
+    // the parser trusts the hot parts as they are
+    const struct ca_opt_hot* hot
+        = (const struct ca_opt_hot*)((const char*)header + header->hot);
+    for (uint64_t i = 0; i < length; i++) {
+        uint8_t negated;
+        memcpy(&negated, &hot[i].quantifier_is_negated, sizeof(negated));
+        if (hot[i].quantifier > CA_OPT_QUANTIFIER_ONLY || negated > 1
+            || (hot[i].refs_mask & ~header->short_opts_mask)
+            || (hot[i].short_opt && !ca_blob_is_short_opt(hot[i].short_opt))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Fills in `schema` from the blob of `header`, already checked with
+ * ca_blob_check(), pointing its arrays at or into the blob. Returns whether
+ * the rest of the blob is well formed.
+ */
+static bool ca_blob_read(struct ca_schema* schema,
+    const struct ca_blob_header* header) {
+    const char* base = (const char*)header;
+    if (!ca_blob_get_string(header, header->program, &schema->program)
+        || !schema->program
+        || !ca_blob_get_string(header, header->description,
+            &schema->description)
+        || !ca_blob_get_string(header, header->ver_info, &schema->ver_info)
+        || !ca_blob_get_string(header, header->env_prefix,
+            &schema->env_prefix)
+        || !ca_blob_get_string(header, header->config_path,
+            &schema->config_path)
+        || !ca_blob_get_strings(header, header->authors,
+            header->authors_length, schema->authors)
+        || !ca_blob_get_strings(header, header->synopses,
+            header->synopses_length, schema->synopses)) {
+        return false;
+    }
+    schema->authors_length = header->authors_length;
+    schema->synopses_length = header->synopses_length;
+
+    // only the cold parts hold pointers, so only they are rebuilt
+    const struct ca_blob_opt* saved
+        = (const struct ca_blob_opt*)(base + header->options);
+    for (uint64_t i = 0; i < header->options_length; i++) {
+        struct ca_opt* opt = &schema->options[i];
+        if (!ca_blob_get_string(header, saved[i].long_opt, &opt->long_opt)
+            || !opt->long_opt
+            || !ca_blob_get_string(header, saved[i].arg_name, &opt->arg_name)
+            || !ca_blob_get_string(header, saved[i].description,
+                &opt->description)
+            || saved[i].type > CA_VALUE_SIZE) {
+            return false;
+        }
+        opt->refs = NULL;
+        opt->result = NULL;
+        opt->type = saved[i].type;
+        opt->handler = NULL;
+        opt->handler_data = NULL;
+    }
+    schema->options_length = header->options_length;
+
+    // the parser only reads these, so they are used where they lie
+    schema->hot = (struct ca_opt_hot*)(base + header->hot);
+    schema->hot_capacity = header->options_length;
+    schema->long_opts = (int*)(base + header->long_opts);
+    schema->long_opts_capacity = header->long_opts_capacity;
+    for (size_t i = 0; i < CA_SHORT_OPT_COUNT; i++) {
+        schema->short_opts[i] = header->short_opts[i];
+    }
+    schema->short_opts_mask = header->short_opts_mask;
+    schema->mflag_mask = header->mflag_mask;
+    schema->help_text = base + header->help_text;
+    schema->help_length = header->help_length;
+    schema->version_text = base + header->version_text;
+    schema->version_length = header->version_length;
+
+    schema->year = header->year;
+    schema->ver_major = header->ver_major;
+    schema->ver_minor = header->ver_minor;
+    schema->ver_patch = header->ver_patch;
+    schema->use_end_of_options = header->use_end_of_options;
+    schema->use_response_files = header->use_response_files;
+    schema->use_man_option = header->use_man_option;
+    schema->use_complete_option = header->use_complete_option;
+    schema->override_help = header->override_help;
+    schema->override_version = header->override_version;
+    schema->frozen = true;
+    return true;
+}
+
+const struct ca_schema* ca_schema_load(const void* blob, size_t size) {
+    const struct ca_blob_header* header = blob;
+    if (!blob || !ca_blob_check(header, size)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    // the schema and its cold arrays come in one allocation
+#ifdef CA_STATIC_CAPACITY
+    if (header->options_length > CA_MAX_OPTIONS
+        || header->authors_length > CA_MAX_AUTHORS
+        || header->synopses_length > CA_MAX_SYNOPSES) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    size_t alloc_size = sizeof(struct ca_schema);
+#else
+    size_t alloc_size = sizeof(struct ca_schema)
+                        + sizeof(struct ca_opt) * header->options_length
+                        + sizeof(const char*)
+                              * (header->authors_length
+                                  + header->synopses_length);
+#endif
+    struct ca_memory memory;
+    ca_memory_init(&memory, false);
+    struct ca_schema* schema = ca_memory_alloc(&memory, alloc_size);
+    if (!schema) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(schema, 0, sizeof(*schema));
+    schema->memory = memory;
+#ifdef CA_STATIC_CAPACITY
+    schema->options = schema->options_storage;
+    schema->authors = schema->authors_storage;
+    schema->synopses = schema->synopses_storage;
+#else
+    schema->options = (struct ca_opt*)(schema + 1);
+    schema->authors
+        = (const char**)(schema->options + header->options_length);
+    schema->synopses = schema->authors + header->authors_length;
+#endif
+    schema->options_capacity = header->options_length;
+    schema->authors_capacity = header->authors_length;
+    schema->synopses_capacity = header->synopses_length;
+
+    // a loaded schema has no subcommands, and its text is already laid out
+    schema->subcommands_length = 0;
+    schema->subcommands = NULL;
+    schema->subcommand_slots_capacity = 0;
+    schema->subcommand_slots = NULL;
+    schema->opt_callback = NULL;
+    schema->arg_callback = NULL;
+
+    if (!ca_blob_read(schema, header)) {
+        ca_memory_free(&memory, schema);
+        errno = EINVAL;
+        return NULL;
+    }
+    return schema;
+}
+
+void ca_schema_free(const struct ca_schema* schema) {
+    if (schema) {
+        // `schema` came from the allocator saved in it
+        struct ca_memory memory = schema->memory;
+        ca_memory_free(&memory, (struct ca_schema*)schema);
+    }
+}
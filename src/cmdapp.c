@@ -14,13 +14,19 @@
 #include <ctype.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 #define CA_PRIVATE_SRC
 #include "cmdapp.h"
 #include "dynarr.h"
+#include "stats.h"
 #undef CA_PRIVATE_SRC
 
-/** Global library state. */
+#ifdef CA_ON_UNIX
+    #include <pthread.h>
+#endif
+
+/** Global library state, used by the functions without a context. */
 static struct ca_app app;
 
 // static void _ca_abort(const char* msg) {
@@ -64,30 +70,63 @@ static bool ca_check_arg_consistency(int argc, const char* argv[]) {
     return true;
 }
 
-/** Returns the current year or `CA_NO_YEAR` on failure. */
-static int ca_get_current_year(void) {
-    // https://stackoverflow.com/questions/1442116/how-to-get-the-date-and-time-values-in-a-c-program
-    time_t current_time = time(NULL);
-    if (current_time == (time_t)-1) {
-        return CA_NO_YEAR;
+/**
+ * Returns the position of `flag` in the short option index, or `CA_NO_OPT` if
+ * `flag` cannot be a short option.
+ *
+ * Lowercase letters come first, then uppercase letters, then digits.
+ */
+static int ca_short_opt_index(char flag) {
+    if (flag >= 'a' && flag <= 'z') {
+        return flag - 'a';
+    } else if (flag >= 'A' && flag <= 'Z') {
+        return flag - 'A' + 26;
+    } else if (flag >= '0' && flag <= '9') {
+        return flag - '0' + 26 + 26;
     }
+    return CA_NO_OPT;
+}
 
-    struct tm* tmp = localtime(&current_time);
-    if (tmp == NULL) {
-        return CA_NO_YEAR;
-    }
+static bool ca_is_short_flag(char flag) {
+    return ca_short_opt_index(flag) != CA_NO_OPT;
+}
 
-    struct tm current_localtime = *tmp;
-    return current_localtime.tm_year + 1900 /* base year for time */;
+/** Inverts ca_short_opt_index(). */
+static char ca_short_opt_at(int index) {
+    static const char flags[CA_SHORT_OPT_COUNT + 1] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    return flags[index];
 }
 
-static bool ca_is_short_flag(char flag) {
-    return isalnum(flag);
+/** Returns the bit for `flag` in a mask over the short option index. */
+static uint64_t ca_short_opt_bit(char flag) {
+    return (uint64_t)1 << ca_short_opt_index(flag);
+}
+
+/** Returns the position of the lowest set bit of nonzero `mask`. */
+static int ca_lowest_bit(uint64_t mask) {
+    int index = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+}
+
+/** Returns the number of set bits in `mask`. */
+static size_t ca_count_bits(uint64_t mask) {
+    size_t count = 0;
+    while (mask) {
+        mask &= mask - 1;
+        count++;
+    }
+    return count;
 }
 
-/* Parses the given `behavior` string and initializes `opt`. Returns zero on
- * success, nonzero otherwise. */
-static int ca_parse_opt_behavior(struct ca_opt* opt, const char* behavior) {
+/* Parses the given `behavior` string and initializes `hot` and `opt`. Returns
+ * zero on success, nonzero otherwise. */
+static int ca_parse_opt_behavior(struct ca_opt_hot* hot, struct ca_opt* opt,
+    const char* behavior) {
     // no behavior, fall back to defaults
     if (behavior[0] == 0) {
         return 0;
@@ -97,7 +136,7 @@ static int ca_parse_opt_behavior(struct ca_opt* opt, const char* behavior) {
 
     // otherwise we must specify that it takes an argument or is in multiflag
     if (behavior[0] == '.') {
-        opt->flags |= CA_OPT_ARG;
+        hot->flags |= CA_OPT_ARG;
         i++;
 
         if (isalpha(behavior[i])) {
@@ -107,9 +146,15 @@ static int ca_parse_opt_behavior(struct ca_opt* opt, const char* behavior) {
             }
         }
 
+        // we check whether every argument is kept
+        if (behavior[i] == '+') {
+            hot->flags |= CA_OPT_MANY;
+            i++;
+        }
+
         // we check whether the argument is optional
         if (behavior[i] == '?') {
-            opt->flags |= CA_OPT_OPTARG;
+            hot->flags |= CA_OPT_OPTARG;
             i++;
         } else if (behavior[i] == '\0') {
             return 0;
@@ -120,7 +165,7 @@ static int ca_parse_opt_behavior(struct ca_opt* opt, const char* behavior) {
             return 0;
         }
     } else if (behavior[0] == '*') {
-        opt->flags |= CA_OPT_MFLAG;
+        hot->flags |= CA_OPT_MFLAG;
         i++;
 
         // check if no quantifier provided
@@ -138,20 +183,20 @@ static int ca_parse_opt_behavior(struct ca_opt* opt, const char* behavior) {
 
     // check whether quantifier is negated
     if (behavior[i] == '!') {
-        opt->quantifier_is_negated = true;
+        hot->quantifier_is_negated = true;
         i++;
     }
 
     // determine quantifier
     switch (behavior[i]) {
         case '@':
-            opt->quantifier = CA_OPT_QUANTIFIER_ANY;
+            hot->quantifier = CA_OPT_QUANTIFIER_ANY;
             break;
         case '&':
-            opt->quantifier = CA_OPT_QUANTIFIER_ALL;
+            hot->quantifier = CA_OPT_QUANTIFIER_ALL;
             break;
         case '<':
-            opt->quantifier = CA_OPT_QUANTIFIER_ONLY;
+            hot->quantifier = CA_OPT_QUANTIFIER_ONLY;
             break;
         default:
             return 1;
@@ -160,717 +205,2728 @@ static int ca_parse_opt_behavior(struct ca_opt* opt, const char* behavior) {
     // remaining input [i + 1, length) is list of flags
     opt->refs = behavior + i + 1;
 
-    // validate that it is only a list of flags
+    // validate that it is only a list of flags and compile it into a mask
     for (size_t i = 0; opt->refs[i]; i++) {
         if (!ca_is_short_flag(opt->refs[i])) {
             return 1;
         }
+        hot->refs_mask |= ca_short_opt_bit(opt->refs[i]);
     }
 
     return 0;
 }
 
+/** Hashes the first `length` bytes of a long option with 32-bit FNV-1a. */
+static uint32_t ca_hash_long_opt(const char* long_opt, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)long_opt[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 /**
- * Finds the option associated with `short_opt` if it is non-`'\0'` or
- * `long_opt` if it is non-`NULL`.
+ * Finds the index of the option whose long option is the first `length` bytes
+ * of `name`, which need not be terminated there, or `CA_NO_OPT` if there is
+ * none.
+ *
+ * @pre The schema is frozen.
  */
-static struct ca_opt* ca_lookup_opt(char short_opt, const char* long_opt) {
-    struct ca_opt* short_opt_cache[26 + 26 + 10] = {NULL};
+static int ca_lookup_long_opt(const struct ca_schema* schema, const char* name,
+    size_t length) {
+    size_t mask = schema->long_opts_capacity - 1;
+    size_t slot = ca_hash_long_opt(name, length) & mask;
+    while (schema->long_opts[slot] != CA_NO_OPT) {
+        int index = schema->long_opts[slot];
+        const char* long_opt = schema->options[index].long_opt;
+        if (strncmp(long_opt, name, length) == 0 && long_opt[length] == '\0') {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return CA_NO_OPT;
+}
 
+/**
+ * Finds the index of the option associated with `short_opt` if it is
+ * non-`'\0'` or `long_opt` if it is non-`NULL`, or `CA_NO_OPT` if there is
+ * none.
+ *
+ * @pre The schema is frozen if `long_opt` is used.
+ */
+static int ca_lookup_opt(const struct ca_schema* schema, char short_opt,
+    const char* long_opt) {
     if (short_opt != '\0') {
-        int map_index = islower(short_opt)   ? short_opt - 'a'
-                        : isupper(short_opt) ? short_opt - 'A' + 26
-                        : isdigit(short_opt) ? short_opt - '0' + 26 + 26
-                                             : -1;
-        if (short_opt_cache[map_index]) {
-            return short_opt_cache[map_index];
-        }
-        for (size_t i = 0; i < app.options_length; i++) {
-            if (app.options[i].short_opt == short_opt) {
-                return short_opt_cache[map_index] = &app.options[i];
-            }
+        int map_index = ca_short_opt_index(short_opt);
+        if (map_index == CA_NO_OPT) {
+            return CA_NO_OPT;
         }
+        return schema->short_opts[map_index];
     } else if (long_opt != NULL) {
-        for (size_t i = 0; i < app.options_length; i++) {
-            if (strcmp(app.options[i].long_opt, long_opt) == 0) {
-                return &app.options[i];
-            }
-        }
+        return ca_lookup_long_opt(schema, long_opt, strlen(long_opt));
     }
-    return NULL;
+    return CA_NO_OPT;
 }
 
-static void print_authors(void) {
-    switch (app.authors_length) {
-        case 1:
-            printf("%s", app.authors[0]);
-            break;
-        case 2:
-            printf("%s and %s", app.authors[0], app.authors[1]);
-            break;
-        default: {
-            for (size_t i = 0; i < app.authors_length; i++) {
-                if (i) {
-                    printf(", ");
-                }
-                if (i + 1 == app.authors_length) {
-                    printf("and ");
-                }
-                printf("%s", app.authors[i]);
-            }
-            break;
-        }
+int ca_state_init(struct ca_parse_state* state,
+    const struct ca_schema* schema, struct ca_memory* memory) {
+    state->schema = schema;
+
+    // a state of its own shares no arena, so it may be used on any thread
+    if (!memory) {
+        ca_memory_init(&state->own_memory, false);
+        memory = &state->own_memory;
+    }
+    state->memory = memory;
+    state->argc = 0;
+    state->argv = NULL;
+
+    // nothing to parse until ca_state_reset()
+    state->next_arg = 0;
+    state->cluster = NULL;
+    state->only_args = false;
+    state->pending_opt = CA_NO_OPT;
+    state->arg_index = -1;
+    state->pending_index = -1;
+    state->held_arg = NULL;
+    state->exit = CA_EXIT_NONE;
+    state->had_arg = false;
+    state->subcommand = CA_NO_OPT;
+    state->subcommand_arg = 0;
+    state->complete_arg = 0;
+
+    // the environment and config file are read on the first parse
+    state->fallbacks_read = false;
+    state->fallbacks_length = 0;
+    state->fallbacks_capacity = 0;
+    state->fallbacks = NULL;
+    state->env_fallbacks = 0;
+    state->has_config = false;
+    state->config_error = 0;
+
+    // no response files read yet
+    if (!ca_dynamic_new(state->memory, state->responses,
+            state->responses_length, state->responses_capacity)) {
+        errno = ENOMEM;
+        return 1;
+    }
+    state->tokens = NULL;
+    state->tokens_end = NULL;
+
+    // no line copied until ca_state_parse_line()
+    state->line_capacity = 0;
+    state->line = NULL;
+
+    // initialize empty results array
+    if (!ca_dynamic_new(state->memory, state->results, state->results_length,
+            state->results_capacity)) {
+        errno = ENOMEM;
+        return 1;
+    }
+
+    // initialize empty passed options array
+    if (!ca_dynamic_new(state->memory, state->passed, state->passed_length,
+            state->passed_capacity)) {
+        errno = ENOMEM;
+        return 1;
+    }
+    state->passed_mask = 0;
+
+    // errors are printed by default, and each ends the parse
+    state->quiet = false;
+    state->error = CA_ERROR_NONE;
+    state->halted = false;
+    state->diagnostics = NULL;
+    state->diagnostics_capacity = 0;
+    state->diagnostics_length = 0;
+
+    // the per-option arrays are sized on each parse
+    state->options_capacity = 0;
+    state->was_passed = NULL;
+    state->args = NULL;
+    state->spans = NULL;
+
+    // sized once per parse for the options that accumulate
+    state->values_capacity = 0;
+    state->values = NULL;
+
+    return 0;
+}
+
+void ca_state_deinit(struct ca_parse_state* state) {
+    if (state->responses) {
+        ca_response_close_all(state);
     }
+    ca_dynamic_free(state->memory, state->responses);
+    ca_dynamic_free(state->memory, state->line);
+    ca_state_drop_fallbacks(state);
+    ca_dynamic_free(state->memory, state->fallbacks);
+    ca_dynamic_free(state->memory, state->results);
+    ca_dynamic_free(state->memory, state->passed);
+    ca_dynamic_free(state->memory, state->was_passed);
+    ca_dynamic_free(state->memory, state->args);
+    ca_dynamic_free(state->memory, state->spans);
+    ca_dynamic_free(state->memory, state->values);
 }
 
-int ca_init(int argc, const char* argv[]) {
+static void ca_text_cache_init(struct ca_text_cache* cache) {
+    cache->data = NULL;
+    cache->length = 0;
+    cache->capacity = 0;
+    cache->valid = false;
+}
+
+/** Marks the help and version text of `schema` as out of date. */
+static void ca_schema_changed(struct ca_schema* schema) {
+    schema->help_cache.valid = false;
+    schema->version_cache.valid = false;
+}
+
+/** Initializes `ctx` like ca_init() without registering ca_deinit(). */
+static int ca_ctx_init(struct ca_app* ctx, int argc, const char* argv[]) {
+    struct ca_schema* schema = &ctx->schema;
+
+    // every array of the context comes from here
+    if (ca_memory_init(&schema->memory, true) != 0) {
+        return 1;
+    }
+
     // ensure inputs are safe to use
     if (!ca_check_arg_consistency(argc, argv)) {
         errno = EINVAL;
         return 1;
     }
-    app.argc = argc;
-    app.argv = argv;
 
     // the program name is in the first element of argv
-    app.program = argv[0];
+    schema->program = argv[0];
 
     // no default description
-    app.description = NULL;
+    schema->description = NULL;
 
     // initialize empty authors array
-    app.authors = ca_dynamic_new(const char*, app.authors_length,
-        app.authors_capacity);
-    if (!app.authors) {
+    if (!ca_dynamic_new(&schema->memory, schema->authors,
+            schema->authors_length, schema->authors_capacity)) {
         errno = ENOMEM;
         return 1;
     }
 
     // no year provided initially
-    app.year = CA_NO_YEAR;
+    schema->year = CA_NO_YEAR;
 
     // v0.0.0
-    app.ver_major = 0;
-    app.ver_minor = 0;
-    app.ver_patch = 0;
+    schema->ver_major = 0;
+    schema->ver_minor = 0;
+    schema->ver_patch = 0;
 
     // initialize empty synopses array
-    app.synopses = ca_dynamic_new(const char*, app.synopses_length,
-        app.synopses_capacity);
-    if (!app.synopses) {
+    if (!ca_dynamic_new(&schema->memory, schema->synopses,
+            schema->synopses_length, schema->synopses_capacity)) {
         errno = ENOMEM;
         return 1;
     }
 
     // default additional versioning information
-    app.ver_info = "All rights reserved.";
+    schema->ver_info = "All rights reserved.";
 
     // default: -- ends the option list
-    app.use_end_of_options = true;
-
-    // initialize empty synopses array
-    app.options = ca_dynamic_new(struct ca_opt, app.options_length,
-        app.options_capacity);
-    if (!app.options) {
+    schema->use_end_of_options = true;
+
+    // default: @path is an ordinary argument
+    schema->use_response_files = false;
+    schema->use_man_option = false;
+    schema->use_complete_option = false;
+
+    // no fallbacks for options left off the command line
+    schema->env_prefix = NULL;
+    schema->config_path = NULL;
+
+    // initialize empty options array, along with its hot parts, which share
+    // its length
+    if (!ca_dynamic_new(&schema->memory, schema->options,
+            schema->options_length, schema->options_capacity)
+        || !ca_dynamic_new(&schema->memory, schema->hot,
+            schema->options_length, schema->hot_capacity)) {
         errno = ENOMEM;
         return 1;
     }
 
-    // initialize empty results array
-    app.results = ca_dynamic_new(struct ca_parse_result, app.results_length,
-        app.results_capacity);
-    if (!app.results) {
+    // no short options registered yet
+    for (size_t i = 0; i < CA_SHORT_OPT_COUNT; i++) {
+        schema->short_opts[i] = CA_NO_OPT;
+    }
+    schema->short_opts_mask = 0;
+    schema->mflag_mask = 0;
+
+    // the long option table is built on freeze
+    schema->long_opts_capacity = 0;
+    schema->long_opts = NULL;
+    schema->frozen = false;
+
+    // initialize empty subcommands array, whose name table is also built on
+    // freeze; the fixed build has none
+#ifdef CA_STATIC_CAPACITY
+    schema->subcommands_length = 0;
+    schema->subcommands_capacity = 0;
+    schema->subcommands = NULL;
+#else
+    if (!ca_dynamic_new(&schema->memory, schema->subcommands,
+            schema->subcommands_length, schema->subcommands_capacity)) {
         errno = ENOMEM;
         return 1;
     }
+#endif
+    schema->subcommand_slots_capacity = 0;
+    schema->subcommand_slots = NULL;
 
     // no callbacks by default
-    app.opt_callback = NULL;
-    app.arg_callback = NULL;
+    schema->opt_callback = NULL;
+    schema->arg_callback = NULL;
 
     // supply default --help and --version implementations
-    app.override_help = false;
-    app.override_version = false;
-
-    // register deinitialization on program exit
-    atexit(ca_deinit);
+    schema->override_help = false;
+    schema->override_version = false;
+    schema->help_text = NULL;
+    schema->help_length = 0;
+    schema->version_text = NULL;
+    schema->version_length = 0;
+
+    // laid out the first time they are printed
+    ca_text_cache_init(&schema->help_cache);
+    ca_text_cache_init(&schema->version_cache);
+
+    // ca_ctx_parse() parses argv with its own state
+    if (ca_state_init(&ctx->state, schema, &schema->memory) != 0) {
+        return 1;
+    }
+    ctx->argc = argc;
+    ctx->argv = argv;
+    ctx->sub = NULL;
 
     return 0;
 }
 
-void ca_deinit() {
-    free(app.authors);
-    free(app.synopses);
-    free(app.options);
-    free(app.results);
+/** Releases all resources allocated for `ctx`, but not `ctx` itself. */
+static void ca_ctx_deinit(struct ca_app* ctx) {
+    struct ca_memory* memory = &ctx->schema.memory;
+    ca_ctx_free(ctx->sub);
+    ca_state_deinit(&ctx->state);
+    ca_dynamic_free(memory, ctx->schema.authors);
+    ca_dynamic_free(memory, ctx->schema.synopses);
+    ca_dynamic_free(memory, ctx->schema.options);
+    ca_dynamic_free(memory, ctx->schema.hot);
+    ca_dynamic_free(memory, ctx->schema.long_opts);
+    ca_dynamic_free(memory, ctx->schema.subcommands);
+    ca_dynamic_free(memory, ctx->schema.subcommand_slots);
+    ca_dynamic_free(memory, ctx->schema.help_cache.data);
+    ca_dynamic_free(memory, ctx->schema.version_cache.data);
+    ca_memory_deinit(memory);
 }
 
-void ca_description(const char* description) {
+struct ca_app* ca_ctx_new(int argc, const char* argv[]) {
+    struct ca_memory memory;
+    ca_memory_init(&memory, false);
+
+    // zeroed so that a partial initialization can be released
+    struct ca_app* ctx = ca_memory_alloc(&memory, sizeof(*ctx));
+    if (!ctx) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    if (ca_ctx_init(ctx, argc, argv) != 0) {
+        int error = errno;
+        ca_ctx_deinit(ctx);
+        ca_memory_free(&memory, ctx);
+        errno = error;
+        return NULL;
+    }
+    return ctx;
+}
+
+void ca_ctx_free(struct ca_app* ctx) {
+    if (ctx) {
+        // `ctx` came from the same allocator as its arrays
+        struct ca_allocator allocator = ctx->schema.memory.allocator;
+        ca_ctx_deinit(ctx);
+        allocator.free(ctx, allocator.user);
+    }
+}
+
+void ca_ctx_description(struct ca_app* ctx, const char* description) {
     if (description) {
-        app.description = description;
+        ctx->schema.description = description;
+        ca_schema_changed(&ctx->schema);
     }
 }
 
-void ca_author(const char* author) {
+void ca_ctx_author(struct ca_app* ctx, const char* author) {
     if (author) {
-        size_t old = app.authors_length;
-        ca_dynamic_push(&app.authors, app.authors_length, app.authors_capacity,
-            author);
-        assert(app.authors_length == old + 1);
+        // on failure, errno is set and the author is dropped
+        (void)ca_dynamic_push(&ctx->schema.memory, &ctx->schema.authors,
+            ctx->schema.authors_length, ctx->schema.authors_capacity, author);
+        ca_schema_changed(&ctx->schema);
     }
 }
 
-void ca_year(int year) {
+void ca_ctx_year(struct ca_app* ctx, int year) {
     if (year >= 0) {
-        app.year = year;
+        ctx->schema.year = year;
+        ca_schema_changed(&ctx->schema);
     }
 }
 
-void ca_version(int major, int minor, int patch) {
+void ca_ctx_version(struct ca_app* ctx, int major, int minor, int patch) {
     if (major >= 0 && minor >= 0 && patch >= 0) {
-        app.ver_major = major;
-        app.ver_minor = minor;
-        app.ver_patch = patch;
+        ctx->schema.ver_major = major;
+        ctx->schema.ver_minor = minor;
+        ctx->schema.ver_patch = patch;
+        ca_schema_changed(&ctx->schema);
     }
 }
 
-void ca_versioning_info(const char* info) {
+void ca_ctx_versioning_info(struct ca_app* ctx, const char* info) {
     if (info) {
-        app.ver_info = info;
+        ctx->schema.ver_info = info;
+        ca_schema_changed(&ctx->schema);
     }
 }
 
-void ca_synopsis(const char* synopsis) {
+void ca_ctx_synopsis(struct ca_app* ctx, const char* synopsis) {
     if (synopsis) {
-        ca_dynamic_push(&app.synopses, app.synopses_length,
-            app.synopses_capacity, synopsis);
+        // on failure, errno is set and the synopsis is dropped
+        (void)ca_dynamic_push(&ctx->schema.memory, &ctx->schema.synopses,
+            ctx->schema.synopses_length, ctx->schema.synopses_capacity,
+            synopsis);
+        ca_schema_changed(&ctx->schema);
     }
 }
 
-void ca_use_end_of_options(bool use) {
-    app.use_end_of_options = use;
+void ca_ctx_use_end_of_options(struct ca_app* ctx, bool use) {
+    ctx->schema.use_end_of_options = use;
 }
 
-bool* ca_opt(char short_opt, const char* long_opt, const char* behavior,
-    const char** result, const char* description) {
+void ca_ctx_use_man_option(struct ca_app* ctx, bool use) {
+    ctx->schema.use_man_option = use;
+}
+
+void ca_ctx_use_complete_option(struct ca_app* ctx, bool use) {
+    ctx->schema.use_complete_option = use;
+}
+
+void ca_ctx_use_response_files(struct ca_app* ctx, bool use) {
+    ctx->schema.use_response_files = use;
+}
+
+void ca_ctx_env_prefix(struct ca_app* ctx, const char* prefix) {
+    ctx->schema.env_prefix = prefix;
+}
+
+void ca_ctx_config_file(struct ca_app* ctx, const char* path) {
+    ctx->schema.config_path = path;
+}
+
+void ca_ctx_override_help_version(struct ca_app* ctx, bool override_help,
+    bool override_version) {
+    ctx->schema.override_help = override_help;
+    ctx->schema.override_version = override_version;
+}
+
+void ca_ctx_set_help_text(struct ca_app* ctx, const char* text,
+    size_t length) {
+    ctx->schema.help_text = text;
+    ctx->schema.help_length = text ? length : 0;
+    ca_schema_changed(&ctx->schema);
+}
+
+void ca_ctx_set_version_text(struct ca_app* ctx, const char* text,
+    size_t length) {
+    ctx->schema.version_text = text;
+    ctx->schema.version_length = text ? length : 0;
+    ca_schema_changed(&ctx->schema);
+}
+
+/** Adds the option at `index` to the long option table of `schema`. */
+static void ca_schema_insert_long_opt(struct ca_schema* schema, int index) {
+    const char* long_opt = schema->options[index].long_opt;
+    size_t mask = schema->long_opts_capacity - 1;
+    size_t slot = ca_hash_long_opt(long_opt, strlen(long_opt)) & mask;
+    while (schema->long_opts[slot] != CA_NO_OPT) {
+        slot = (slot + 1) & mask;
+    }
+    schema->long_opts[slot] = index;
+}
+
+/** Rebuilds the long option table of `schema` from its options. */
+static void ca_schema_rehash_long_opts(struct ca_schema* schema) {
+    for (size_t i = 0; i < schema->long_opts_capacity; i++) {
+        schema->long_opts[i] = CA_NO_OPT;
+    }
+    for (size_t i = 0; i < schema->options_length; i++) {
+        ca_schema_insert_long_opt(schema, (int)i);
+    }
+}
+
+/**
+ * Grows the long option table of `schema` so that it can hold `length`
+ * options, rehashing those it has. Sets `errno` on failure.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+static int ca_schema_reserve_long_opts(struct ca_schema* schema,
+    size_t length) {
+    // keep the load factor at or below one half so probe sequences stay short
+    size_t capacity = 16;
+    while (capacity < length * 2) {
+        capacity *= 2;
+    }
+    if (capacity <= schema->long_opts_capacity) {
+        return 0;
+    }
+#ifdef CA_STATIC_CAPACITY
+    // the storage fits the table for up to CA_MAX_OPTIONS options
+    if (length > CA_MAX_OPTIONS) {
+        errno = ENOMEM;
+        return 1;
+    }
+    int* long_opts = schema->long_opts_storage;
+#else
+    int* long_opts = ca_memory_realloc(&schema->memory, schema->long_opts,
+        sizeof(int) * schema->long_opts_capacity, sizeof(int) * capacity);
+#endif
+    if (!long_opts) {
+        errno = ENOMEM;
+        return 1;
+    }
+    schema->long_opts = long_opts;
+    schema->long_opts_capacity = capacity;
+    ca_schema_rehash_long_opts(schema);
+    return 0;
+}
+
+/**
+ * Registers an option that converts its argument to `type`; see
+ * ca_ctx_typed_opt(), which times this.
+ */
+static int ca_ctx_register_opt(struct ca_app* ctx, char short_opt,
+    const char* long_opt, const char* behavior, enum ca_value_type type,
+    void* result, const char* description) {
+    struct ca_schema* schema = &ctx->schema;
+
     // these parameters must be passed
     if (!long_opt || !behavior) {
         errno = EINVAL;
-        return NULL;
+        return -1;
     }
     if (short_opt != '\0' && !ca_is_short_flag(short_opt)) {
         errno = EINVAL;
-        return NULL;
+        return -1;
     }
 
-    // initialize option
+    // initialize option, padding included, since it is saved as is in blobs
+    struct ca_opt_hot hot;
+    memset(&hot, 0, sizeof(hot));
+    hot.refs_mask = 0;
+    hot.flags = 0;
+    hot.quantifier = CA_OPT_QUANTIFIER_NONE;
+    hot.quantifier_is_negated = false;
+    hot.short_opt = short_opt;
     struct ca_opt opt;
-    opt.short_opt = short_opt;
     opt.long_opt = long_opt;
+    opt.refs = NULL;
     opt.result = result;
-    opt.flags = 0;
-    opt.quantifier_is_negated = false;
-    opt.quantifier = CA_OPT_QUANTIFIER_NONE;
+    opt.type = type;
     opt.arg_name = "ARG";
     opt.description = description;
+    opt.handler = NULL;
+    opt.handler_data = NULL;
+
+    // the automatic options are recognized once here rather than per parse
+    if (strcmp(long_opt, "help") == 0) {
+        hot.flags |= CA_OPT_HELP;
+    } else if (strcmp(long_opt, "version") == 0) {
+        hot.flags |= CA_OPT_VERSION;
+    }
 
     // parse behavior
-    if (ca_parse_opt_behavior(&opt, behavior) != 0) {
+    if (ca_parse_opt_behavior(&hot, &opt, behavior) != 0) {
         errno = EINVAL;
-        return NULL;
+        return -1;
     }
 
-    // if it takes an arg, it has to store it somewhere
-    if (opt.flags & CA_OPT_ARG && !result) {
+    // if it takes an arg, it has to store it somewhere, and only an arg can
+    // be converted
+    if ((hot.flags & CA_OPT_ARG && !result)
+        || (type != CA_VALUE_STRING && !(hot.flags & CA_OPT_ARG))) {
         errno = EINVAL;
-        return NULL;
+        return -1;
+    }
+
+    // an option that excludes itself could never be passed
+    if (short_opt != '\0' && hot.quantifier == CA_OPT_QUANTIFIER_ANY
+        && hot.quantifier_is_negated
+        && hot.refs_mask & ca_short_opt_bit(short_opt)) {
+        ca_print_error("--%s conflicts with itself\n", long_opt);
+        errno = EINVAL;
+        return -1;
+    }
+
+    // names are checked against the same tables the parser looks them up in,
+    // so each check costs one probe
+    if (short_opt != '\0'
+        && schema->short_opts[ca_short_opt_index(short_opt)] != CA_NO_OPT) {
+        ca_print_error("flag -%c is already registered\n", short_opt);
+        errno = EEXIST;
+        return -1;
+    }
+    if (schema->long_opts_capacity > 0
+        && ca_lookup_long_opt(schema, long_opt, strlen(long_opt))
+               != CA_NO_OPT) {
+        ca_print_error("flag --%s is already registered\n", long_opt);
+        errno = EEXIST;
+        return -1;
+    }
+
+    // the table grows first, so that nothing has changed if it cannot; the
+    // hot parts go next: if the option itself cannot be added, the extra
+    // entry is simply overwritten by the next one
+    size_t hot_length = schema->options_length;
+    if (ca_schema_reserve_long_opts(schema, hot_length + 1) != 0
+        || ca_dynamic_push(&schema->memory, &schema->hot, hot_length,
+            schema->hot_capacity, hot) != 0
+        || ca_dynamic_push(&schema->memory, &schema->options,
+            schema->options_length, schema->options_capacity, opt) != 0) {
+        return -1;
+    }
+    int index = (int)(schema->options_length - 1);
+    ca_schema_insert_long_opt(schema, index);
+    if (short_opt != '\0') {
+        schema->short_opts[ca_short_opt_index(short_opt)] = index;
+        if (hot.flags & CA_OPT_MFLAG) {
+            schema->mflag_mask |= ca_short_opt_bit(short_opt);
+        }
+        schema->short_opts_mask |= ca_short_opt_bit(short_opt);
     }
 
-    ca_dynamic_push(&app.options, app.options_length, app.options_capacity,
-        opt);
+    // the refs have to be checked again
+    schema->frozen = false;
+    ca_schema_changed(schema);
 
-    return &app.options[app.options_length - 1].was_passed;
+    return (int)(schema->options_length - 1);
 }
 
-bool* ca_long_opt(const char* long_opt, const char* behavior,
-    const char** result, const char* description) {
-    return ca_opt(0, long_opt, behavior, result, description);
+/**
+ * Registers an option whose argument is converted to `type` and written to
+ * `*result`; see ca_ctx_opt().
+ */
+static int ca_ctx_typed_opt(struct ca_app* ctx, char short_opt,
+    const char* long_opt, const char* behavior, enum ca_value_type type,
+    void* result, const char* description) {
+    ca_stat_begin(start);
+    int handle = ca_ctx_register_opt(ctx, short_opt, long_opt, behavior, type,
+        result, description);
+    ca_stat_end(&ctx->schema.memory, register_ns, start);
+    return handle;
 }
 
-void ca_set_callbacks(void (*opt_callback)(char, const char*, const char*,
-                          void*),
-    void (*arg_callback)(const char*, void*)) {
-    app.opt_callback = opt_callback;
-    app.arg_callback = arg_callback;
+int ca_ctx_opt(struct ca_app* ctx, char short_opt, const char* long_opt,
+    const char* behavior, const char** result, const char* description) {
+    return ca_ctx_typed_opt(ctx, short_opt, long_opt, behavior,
+        CA_VALUE_STRING, result, description);
 }
 
-/** Adds an option to the results array. */
-static void ca_parsed_opt(struct ca_opt* opt, const char* arg) {
-    struct ca_parse_result result;
-    result.opt = opt;
-    result.arg = arg;
-    opt->was_passed = true;
-    ca_dynamic_push(&app.results, app.results_length, app.results_capacity,
-        result);
-    app.options_count++;
+int ca_ctx_long_opt(struct ca_app* ctx, const char* long_opt,
+    const char* behavior, const char** result, const char* description) {
+    return ca_ctx_opt(ctx, 0, long_opt, behavior, result, description);
 }
 
-/** Adds an argument to the results array. */
-static void ca_parsed_arg(struct ca_opt** last_opt, const char* arg) {
-    struct ca_parse_result result;
-    if (*last_opt) {
-        result.opt = *last_opt;
-        result.arg = arg;
-        (*last_opt)->was_passed = true;
-        *last_opt = NULL;
-    } else {
-        result.opt = NULL;
-        result.arg = arg;
-    }
-    ca_dynamic_push(&app.results, app.results_length, app.results_capacity,
-        result);
+int ca_ctx_opt_int(struct ca_app* ctx, char short_opt, const char* long_opt,
+    const char* behavior, int* result, const char* description) {
+    return ca_ctx_typed_opt(ctx, short_opt, long_opt, behavior, CA_VALUE_INT,
+        result, description);
 }
 
-/** Iterate over the provided command line arguments and construct a resulting
- * array of options and arguments. */
-static int ca_construct_results(void) {
-    // when -- is passed and support for it is enabled, all subsequent arguments
-    // are treated only as arguments
-    bool only_args_now = false;
+int ca_ctx_opt_u64(struct ca_app* ctx, char short_opt, const char* long_opt,
+    const char* behavior, uint64_t* result, const char* description) {
+    return ca_ctx_typed_opt(ctx, short_opt, long_opt, behavior, CA_VALUE_U64,
+        result, description);
+}
 
-    // we start at 1 because argv[0] is already in app.program and it's useless
-    // here
-    int i = 1;
+int ca_ctx_opt_double(struct ca_app* ctx, char short_opt, const char* long_opt,
+    const char* behavior, double* result, const char* description) {
+    return ca_ctx_typed_opt(ctx, short_opt, long_opt, behavior,
+        CA_VALUE_DOUBLE, result, description);
+}
 
-    // the previous option that takes an argument
-    // this introduces code dup I need to figure out how to fix
-    // specifically, anytime there is arg_callback
-    struct ca_opt* last_opt = NULL;
+int ca_ctx_opt_size(struct ca_app* ctx, char short_opt, const char* long_opt,
+    const char* behavior, size_t* result, const char* description) {
+    return ca_ctx_typed_opt(ctx, short_opt, long_opt, behavior, CA_VALUE_SIZE,
+        result, description);
+}
 
-    // go through the command line arguments
-    while (i < app.argc) {
-        const char* cur = app.argv[i];
+/**
+ * Builds the table of subcommand names of `schema`, if it has any. Sets
+ * `errno` on failure.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+static int ca_schema_index_subcommands(struct ca_schema* schema) {
+#ifdef CA_STATIC_CAPACITY
+    // the fixed build never registers a subcommand
+    (void)schema;
+    return 0;
+#else
+    if (schema->subcommands_length == 0) {
+        return 0;
+    }
 
-        if (only_args_now) {
-            // handle the case of after --
-            ca_parsed_arg(&last_opt, cur);
-            i++;
-        } else if (cur[0] == '-') {
-            // it could be a flag
+    // sized like the long option table
+    size_t capacity = 16;
+    while (capacity < schema->subcommands_length * 2) {
+        capacity *= 2;
+    }
+    if (capacity != schema->subcommand_slots_capacity) {
+        int* slots = ca_memory_realloc(&schema->memory,
+            schema->subcommand_slots,
+            sizeof(int) * schema->subcommand_slots_capacity,
+            sizeof(int) * capacity);
+        if (!slots) {
+            errno = ENOMEM;
+            return 1;
+        }
+        schema->subcommand_slots = slots;
+        schema->subcommand_slots_capacity = capacity;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        schema->subcommand_slots[i] = CA_NO_OPT;
+    }
 
-            // handle '-' (common for stdin)
-            if (cur[1] == '\0') {
-                ca_parsed_arg(&last_opt, cur);
-                i++;
-                continue;
+    // the first registration of a name takes precedence
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < schema->subcommands_length; i++) {
+        const char* name = schema->subcommands[i].name;
+        size_t slot = ca_hash_long_opt(name, strlen(name)) & mask;
+        while (schema->subcommand_slots[slot] != CA_NO_OPT) {
+            int other = schema->subcommand_slots[slot];
+            if (strcmp(schema->subcommands[other].name, name) == 0) {
+                break;
             }
+            slot = (slot + 1) & mask;
+        }
+        if (schema->subcommand_slots[slot] == CA_NO_OPT) {
+            schema->subcommand_slots[slot] = (int)i;
+        }
+    }
+    return 0;
+#endif
+}
 
-            // handle '--'
-            if (strcmp(cur, "--") == 0) {
-                if (app.use_end_of_options) {
-                    only_args_now = true;
-                } else {
-                    ca_parsed_arg(&last_opt, cur);
-                }
-                i++;
-                continue;
-            }
+/**
+ * Finds the index of the subcommand `name` in `schema`, or `CA_NO_OPT` if
+ * there is none.
+ *
+ * @pre The schema is frozen.
+ */
+static int ca_lookup_subcommand(const struct ca_schema* schema,
+    const char* name) {
+    if (schema->subcommand_slots_capacity == 0) {
+        return CA_NO_OPT;
+    }
+    size_t mask = schema->subcommand_slots_capacity - 1;
+    size_t slot = ca_hash_long_opt(name, strlen(name)) & mask;
+    while (schema->subcommand_slots[slot] != CA_NO_OPT) {
+        int index = schema->subcommand_slots[slot];
+        if (strcmp(schema->subcommands[index].name, name) == 0) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return CA_NO_OPT;
+}
 
-            // if last opt has not been resolved, we're at a flag now, so it
-            // better have needed an _optional_ argument
-            if (last_opt && !(last_opt->flags & CA_OPT_OPTARG)) {
-                ca_print_error("--%s missing required argument\n",
-                    last_opt->long_opt);
-                return 1;
+/** Builds the lookup tables of `schema`; see ca_ctx_freeze(). */
+static int ca_schema_freeze(struct ca_schema* schema) {
+    // every ref must name a registered short option; refs may be forward
+    // declared, so this can only be decided once registration is done
+    uint64_t refs_mask = 0;
+    for (size_t i = 0; i < schema->options_length; i++) {
+        refs_mask |= schema->hot[i].refs_mask;
+    }
+    uint64_t unknown_refs = refs_mask & ~schema->short_opts_mask;
+    if (unknown_refs) {
+        char flag = ca_short_opt_at(ca_lowest_bit(unknown_refs));
+        for (size_t i = 0; i < schema->options_length; i++) {
+            if (schema->hot[i].refs_mask & ca_short_opt_bit(flag)) {
+                ca_print_error("unknown flag -%c in definition of --%s\n",
+                    flag, schema->options[i].long_opt);
+                break;
             }
-            last_opt = NULL;
+        }
+        errno = EINVAL;
+        return 1;
+    }
 
-            // we now parse the option and argument (if there)
-            struct ca_opt* opt = NULL;
-            const char* arg = NULL;
+    // an empty schema still needs an empty table to look up in
+    if (ca_schema_reserve_long_opts(schema, schema->options_length) != 0) {
+        return 1;
+    }
 
-            // determine whether it is a long or short option and search for the
-            // corresponding option struct
-            if (cur[1] != '-' /* short opt */) {
-                char flag = cur[1];
+    if (ca_schema_index_subcommands(schema) != 0) {
+        return 1;
+    }
 
-                // the first character after '-' should always be a valid option
-                opt = ca_lookup_opt(flag, NULL);
-                if (!opt) {
-                    ca_print_error("unknown flag -%c\n", flag);
-                    return 1;
-                }
+    schema->frozen = true;
+    return 0;
+}
 
-                // we might have more characters though
-                if (cur[2] != '\0') {
-                    // we have a bunch of flags potentially after a short opt
-                    // can only be multiflag if first is multiflag and then all
-                    // others are too
-                    if (opt->flags & CA_OPT_MFLAG) {
-                        for (size_t j = 2; cur[j]; j++) {
-                            opt = ca_lookup_opt(cur[j], NULL);
-                            if (!opt) {
-                                ca_print_error("unknown flag -%c\n", cur[j]);
-                                return 1;
-                            }
-                            if (!(opt->flags & CA_OPT_MFLAG)) {
-                                ca_print_error(
-                                    "-%c must be passed separately from -%c\n",
-                                    opt->short_opt, flag);
-                                return 1;
-                            }
-                        }
-                        for (size_t j = 1; cur[j]; j++) {
-                            // this will work now because we tested it above
-                            opt = ca_lookup_opt(cur[j], NULL);
-                            ca_parsed_opt(opt, NULL);
-                        }
-                        i++;
-                        continue;
-                    } else {
-                        // treat as connected option
-                        // example: -I/usr/include is -I /usr/include
-                        opt = ca_lookup_opt(flag, NULL);
-                        if (!(opt->flags & CA_OPT_ARG)) {
-                            ca_print_error("-%c does not take arguments\n",
-                                flag);
-                            return 1;
-                        }
-                        arg = cur + 2;
-                    }
-                }
-            } else /* long opt */ {
-                opt = ca_lookup_opt('\0', cur + 2);
-                if (!opt) {
-                    ca_print_error("unknown flag %s\n", cur);
-                    return 1;
-                }
-            }
-            if (!arg && opt->flags & CA_OPT_ARG) {
-                // delay resolution of argument until next iteration or loop end
-                last_opt = opt;
-            } else {
-                ca_parsed_opt(opt, arg);
-            }
-            i++;
-        } else {
-            // otherwise it must be an argument
-            ca_parsed_arg(&last_opt, cur);
-            i++;
+/**
+ * Unregisters every option of `schema` from `length` on, restoring the option
+ * tables and masks to what they were before those were registered.
+ */
+static void ca_schema_truncate_opts(struct ca_schema* schema, size_t length) {
+    schema->options_length = length;
+    schema->short_opts_mask = 0;
+    schema->mflag_mask = 0;
+    for (size_t i = 0; i < CA_SHORT_OPT_COUNT; i++) {
+        int opt = schema->short_opts[i];
+        if (opt == CA_NO_OPT) {
+            continue;
+        }
+        if ((size_t)opt >= length) {
+            schema->short_opts[i] = CA_NO_OPT;
+        } else if (schema->hot[opt].flags & CA_OPT_MFLAG) {
+            schema->mflag_mask |= (uint64_t)1 << i;
+        }
+    }
+    for (size_t i = 0; i < length; i++) {
+        char short_opt = schema->hot[i].short_opt;
+        if (short_opt != '\0') {
+            schema->short_opts_mask |= ca_short_opt_bit(short_opt);
         }
     }
+    ca_schema_rehash_long_opts(schema);
+}
 
-    // more code dup
-    if (last_opt && !(last_opt->flags & CA_OPT_OPTARG)) {
-        ca_print_error("--%s missing required argument\n", last_opt->long_opt);
-        return 1;
+/** See ca_ctx_opts(), which times this. */
+static int ca_ctx_register_opts(struct ca_app* ctx,
+    const struct ca_opt_spec* specs, size_t count) {
+    struct ca_schema* schema = &ctx->schema;
+    if (!specs && count > 0) {
+        errno = EINVAL;
+        return -1;
     }
+    size_t first = schema->options_length;
 
-    return 0;
+    // size both halves of the option table once for the whole list
+#ifdef CA_STATIC_CAPACITY
+    if (count > CA_MAX_OPTIONS - first) {
+        errno = ENOMEM;
+        return -1;
+    }
+#else
+    if (count > 0
+        && (ca_dynamic_reserve(&schema->memory, &schema->hot,
+                sizeof(*schema->hot), first + count,
+                &schema->hot_capacity)
+               != 0
+            || ca_dynamic_reserve(&schema->memory, &schema->options,
+                sizeof(*schema->options), first + count,
+                &schema->options_capacity)
+                   != 0)) {
+        return -1;
+    }
+#endif
+    if (ca_schema_reserve_long_opts(schema, first + count) != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const struct ca_opt_spec* spec = &specs[i];
+        if (ca_ctx_register_opt(ctx, spec->short_opt, spec->long_opt,
+                spec->behavior, CA_VALUE_STRING, spec->result,
+                spec->description)
+            < 0) {
+            int error = errno;
+            ca_schema_truncate_opts(schema, first);
+            errno = error;
+            return -1;
+        }
+    }
+    return (int)first;
 }
 
-// this function is a sin upon this earth
-/** Determines whether the parsed results have any conflicts. */
-static int ca_verify_results(void) {
-    // check every option passed
-    for (size_t i = 0; i < app.results_length; i++) {
-        struct ca_parse_result result = app.results[i];
-        if (result.opt) {
-            const struct ca_opt* opt = result.opt;
-            struct ca_opt* ref = NULL;
+int ca_ctx_opts(struct ca_app* ctx, const struct ca_opt_spec* specs,
+    size_t count) {
+    ca_stat_begin(start);
+    int first = ca_ctx_register_opts(ctx, specs, count);
+    ca_stat_end(&ctx->schema.memory, register_ns, start);
+    return first;
+}
 
-            // determine if the quantified proposition holds
-            bool verdict = false;
-            switch (opt->quantifier) {
-                case CA_OPT_QUANTIFIER_ANY: {
-                    // start out false, any success makes true
-                    verdict = false;
-                    for (size_t j = 0; opt->refs[j]; j++) {
-                        ref = ca_lookup_opt(opt->refs[j], NULL);
-                        if (!ref) {
-                            ca_print_error(
-                                "unknown flag -%c in definition of --%s\n",
-                                opt->refs[j], opt->long_opt);
-                            return 1;
-                        }
-                        if (ref->was_passed) {
-                            verdict = true;
-                            break;
-                        }
-                    }
-                    break;
-                }
-                case CA_OPT_QUANTIFIER_ALL: {
-                    // start out true, any failure makes false
-                    verdict = true;
-                    for (size_t j = 0; opt->refs[j]; j++) {
-                        ref = ca_lookup_opt(opt->refs[j], NULL);
-                        if (!ref) {
-                            ca_print_error(
-                                "unknown flag -%c in definition of --%s\n",
-                                opt->refs[j], opt->long_opt);
-                            return 1;
-                        }
-                        if (!ref->was_passed) {
-                            verdict = false;
-                            break;
-                        }
-                    }
-                    break;
-                }
-                case CA_OPT_QUANTIFIER_ONLY: {
-                    // 1. determine how many of the allowed arguments were
-                    // passed
-                    // 2. if more arguments were passed then allowed, there's a
-                    // conflict
-                    verdict = true;
-                    size_t allowed_count = 0;
-                    for (size_t j = 0; opt->refs[j]; j++) {
-                        ref = ca_lookup_opt(opt->refs[j], NULL);
-                        if (!ref) {
-                            ca_print_error(
-                                "unknown flag -%c in definition of --%s\n",
-                                opt->refs[j], opt->long_opt);
-                            return 1;
-                        }
-                        if (ref->was_passed) {
-                            allowed_count++;
-                        }
-                        if (app.options_count > allowed_count) {
-                            verdict = false;
-                        }
-                    }
-                    break;
-                }
-                default: {
-                    verdict = true;
-                    break;
-                }
-            }
-            // negation flips verdict
-            if (opt->quantifier_is_negated) {
-                verdict = !verdict;
-            }
-            // render verdict
-            if (!verdict) {
-                switch (opt->quantifier) {
-                    case CA_OPT_QUANTIFIER_ANY: {
-                        if (opt->quantifier_is_negated) {
-                            ca_print_error("-%c conflicts with --%s\n",
-                                ref->short_opt, opt->long_opt);
-                        } else {
-                            ca_print_error(
-                                "at least one of the specified options for "
-                                "--%s must be passed\n",
-                                opt->long_opt);
-                        }
-                        break;
-                    }
-                    case CA_OPT_QUANTIFIER_ALL: {
-                        if (opt->quantifier_is_negated) {
-                            ca_print_error(
-                                "only some of the specified options for --%s "
-                                "should be passed\n",
-                                opt->long_opt);
-                        } else {
-                            ca_print_error(
-                                "all of the specified options for --%s must be "
-                                "passed\n",
-                                opt->long_opt);
-                        }
-                        break;
-                    }
-                    case CA_OPT_QUANTIFIER_ONLY: {
-                        if (opt->quantifier_is_negated) {
-                            ca_print_error(
-                                "only other options besides those specified "
-                                "for --%s should be passed\n",
-                                opt->long_opt);
-                        } else {
-                            if (opt->short_opt != '\0'
-                                && opt->refs[0] == opt->short_opt) {
-                                ca_print_error(
-                                    "--%s must be passed by itself\n",
-                                    opt->long_opt);
-                            } else {
-                                ca_print_error(
-                                    "--%s can only be passed with allowed "
-                                    "options\n",
-                                    opt->long_opt);
-                            }
-                        }
-                        break;
-                    }
-                    default:
-                        break;
-                }
-                return 1;
-            }
+int ca_ctx_freeze(struct ca_app* ctx) {
+    if (ctx->schema.frozen) {
+        return 0;
+    }
+    ca_stat_begin(start);
+    int status = ca_schema_freeze(&ctx->schema);
+    ca_stat_end(&ctx->schema.memory, register_ns, start);
+    return status;
+}
+
+int ca_ctx_subcommand(struct ca_app* ctx, const char* name,
+    const char* description,
+    void (*register_fn)(struct ca_app* ctx, void* data), void* data) {
+    struct ca_schema* schema = &ctx->schema;
+    if (!name || !register_fn) {
+        errno = EINVAL;
+        return -1;
+    }
+#ifdef CA_STATIC_CAPACITY
+    // a selected subcommand parses into a context of its own, which the fixed
+    // build could only allocate
+    (void)schema;
+    (void)description;
+    (void)data;
+    errno = ENOTSUP;
+    return -1;
+#else
+    struct ca_subcommand subcommand = {name, description, register_fn, data};
+    if (ca_dynamic_push(&schema->memory, &schema->subcommands,
+            schema->subcommands_length, schema->subcommands_capacity,
+            subcommand)
+        != 0) {
+        return -1;
+    }
+
+    // the name table no longer covers every subcommand
+    schema->frozen = false;
+    ca_schema_changed(schema);
+
+    return (int)(schema->subcommands_length - 1);
+#endif
+}
+
+int ca_ctx_selected_subcommand(const struct ca_app* ctx) {
+    return ctx->sub ? ctx->state.subcommand : CA_NO_OPT;
+}
+
+struct ca_app* ca_ctx_subcommand_context(const struct ca_app* ctx) {
+    return ctx->sub;
+}
+
+int ca_ctx_set_handler(struct ca_app* ctx, int handle,
+    void (*handler)(const char* arg, void* data), void* data) {
+    struct ca_schema* schema = &ctx->schema;
+    if (handle < 0 || (size_t)handle >= schema->options_length) {
+        errno = EINVAL;
+        return 1;
+    }
+    schema->options[handle].handler = handler;
+    schema->options[handle].handler_data = data;
+    return 0;
+}
+
+void ca_ctx_set_callbacks(struct ca_app* ctx,
+    void (*opt_callback)(char, const char*, const char*, void*),
+    void (*arg_callback)(const char*, void*)) {
+    ctx->schema.opt_callback = opt_callback;
+    ctx->schema.arg_callback = arg_callback;
+}
+
+/** Prints an error message to standard error in one write. */
+static void ca_write_error(const char* fmt, va_list args);
+
+void ca_report_error(struct ca_parse_state* state, enum ca_error error,
+    int opt, int arg_index, const char* fmt, ...) {
+    if (state->error == CA_ERROR_NONE) {
+        state->error = error;
+    }
+
+    // a collecting parse goes on from anything but running out of memory
+    if (state->diagnostics) {
+        if (state->diagnostics_length < state->diagnostics_capacity) {
+            struct ca_diagnostic* diagnostic
+                = &state->diagnostics[state->diagnostics_length];
+            diagnostic->code = error;
+            diagnostic->opt = opt;
+            diagnostic->arg_index = arg_index;
         }
+        state->diagnostics_length++;
+        if (error == CA_ERROR_NO_MEMORY) {
+            state->halted = true;
+        }
+        return;
+    }
+
+    state->halted = true;
+    if (!state->quiet) {
+        va_list l;
+        va_start(l, fmt);
+        ca_write_error(fmt, l);
+        va_end(l);
+    }
+}
+
+/**
+ * Records that the option at `index` was passed, once per parse. Returns zero
+ * on success, nonzero if memory ran out.
+ */
+static int ca_mark_passed(struct ca_parse_state* state, int index) {
+    if (state->was_passed[index]) {
+        return 0;
+    }
+    if (ca_dynamic_push(state->memory, &state->passed, state->passed_length,
+            state->passed_capacity, index)
+        != 0) {
+        ca_report_error(state, CA_ERROR_NO_MEMORY, CA_NO_OPT, -1,
+            "out of memory\n");
+        return 1;
     }
+    state->was_passed[index] = true;
+    char short_opt = state->schema->hot[index].short_opt;
+    if (short_opt != '\0') {
+        state->passed_mask |= ca_short_opt_bit(short_opt);
+    }
+    return 0;
+}
 
+/** Appends `result` to the results array of `state`. */
+static int ca_push_result(struct ca_parse_state* state,
+    struct ca_parse_result result) {
+    if (ca_dynamic_push(state->memory, &state->results, state->results_length,
+            state->results_capacity, result)
+        != 0) {
+        ca_report_error(state, CA_ERROR_NO_MEMORY, CA_NO_OPT, -1,
+            "out of memory\n");
+        return 1;
+    }
     return 0;
 }
 
-int ca_parse(void* user_data) {
-    // reset all options
-    for (size_t i = 0; i < app.options_length; i++) {
-        app.options[i].was_passed = false;
+/**
+ * How the option at index `opt` ends the parse when passed, which it does if
+ * it is a `--help` or `--version` that is not overridden.
+ */
+static enum ca_exit ca_opt_exit(const struct ca_schema* schema, int opt) {
+    uint8_t flags = schema->hot[opt].flags;
+    if (flags & CA_OPT_HELP && !schema->override_help) {
+        return CA_EXIT_HELP;
     }
-    app.options_count = 0;
-    // clear results array
-    app.results_length = 0;
+    if (flags & CA_OPT_VERSION && !schema->override_version) {
+        return CA_EXIT_VERSION;
+    }
+    return CA_EXIT_NONE;
+}
 
-    // do bulk of the parsing
-    if (ca_construct_results() != 0) {
+/**
+ * Yields the option at index `opt` with `arg`, which may be `NULL`, from the
+ * argument at `arg_index` into `*result`. Returns one on success, or a
+ * negative value on failure.
+ */
+static int ca_yield_opt(struct ca_parse_state* state, int opt,
+    const char* arg, int arg_index, struct ca_parse_result* result) {
+    const struct ca_opt* info = &state->schema->options[opt];
+    size_t length = arg ? strlen(arg) : 0;
+
+    // typed arguments are checked here, so that they convert when published
+    if (arg && info->type != CA_VALUE_STRING) {
+        union {
+            int i;
+            uint64_t u;
+            double d;
+            size_t z;
+        } value;
+        if (ca_parse_value(info->type, arg, length, &value) != 0) {
+            ca_report_error(state, CA_ERROR_BAD_VALUE, opt, arg_index,
+                errno == ERANGE ? "--%s argument out of range: %s\n"
+                                : "--%s argument is not a valid number: %s\n",
+                info->long_opt, arg);
+            return -1;
+        }
+    }
+
+    if (ca_mark_passed(state, opt) != 0) {
+        return -1;
+    }
+    // whatever ended the parse first is what it answers
+    if (state->exit == CA_EXIT_NONE) {
+        state->exit = ca_opt_exit(state->schema, opt);
+    }
+    if (state->schema->hot[opt].flags & CA_OPT_ARG) {
+        state->args[opt] = arg;
+    }
+    result->opt = opt;
+    result->arg_index = arg_index;
+    result->arg = arg;
+    result->arg_length = length;
+    ca_stat_add(state->memory, results, 1);
+    return 1;
+}
+
+/**
+ * Yields `arg`, which is either the argument of the pending option or an
+ * ordinary argument, into `*result`. Returns as ca_yield_opt().
+ */
+static int ca_yield_arg(struct ca_parse_state* state, const char* arg,
+    struct ca_parse_result* result) {
+    int opt = state->pending_opt;
+    if (opt != CA_NO_OPT) {
+        state->pending_opt = CA_NO_OPT;
+        return ca_yield_opt(state, opt, arg, state->pending_index, result);
+    }
+    state->had_arg = true;
+    result->opt = CA_NO_OPT;
+    result->arg_index = state->arg_index;
+    result->arg = arg;
+    result->arg_length = strlen(arg);
+    ca_stat_add(state->memory, results, 1);
+    return 1;
+}
+
+/**
+ * Reports that the pending option of `state` is missing its argument if it
+ * requires one, after which it is no longer pending. Returns zero if it does
+ * not, nonzero otherwise.
+ */
+static int ca_check_pending(struct ca_parse_state* state) {
+    int opt = state->pending_opt;
+    if (opt != CA_NO_OPT && !(state->schema->hot[opt].flags & CA_OPT_OPTARG)) {
+        state->pending_opt = CA_NO_OPT;
+        ca_report_error(state, CA_ERROR_MISSING_ARG, opt,
+            state->pending_index, "--%s missing required argument\n",
+            state->schema->options[opt].long_opt);
         return 1;
     }
+    return 0;
+}
 
-    // check for conflicts
-    if (ca_verify_results() != 0) {
+/**
+ * Reads the next argument of `state` into `*arg`, taking it from a response
+ * file if one is being read. Returns one if an argument was read, zero at the
+ * end of the command line, or a negative value on failure.
+ */
+static int ca_read_arg(struct ca_parse_state* state, const char** arg) {
+    if (state->held_arg) {
+        *arg = state->held_arg;
+        state->held_arg = NULL;
         return 1;
     }
 
-    // run the callbacks
-    for (size_t i = 0; i < app.results_length; i++) {
-        struct ca_parse_result result = app.results[i];
-        if (result.opt) {
-            if (!app.override_help
-                && strcmp(result.opt->long_opt, "help") == 0) {
-                ca_print_help();
-            } else if (!app.override_version
-                       && strcmp(result.opt->long_opt, "version") == 0) {
-                ca_print_version();
-            } else {
-                if (result.opt->flags & CA_OPT_ARG) {
-                    *result.opt->result = result.arg;
-                }
-                if (app.opt_callback) {
-                    app.opt_callback(result.opt->short_opt,
-                        result.opt->long_opt, result.arg, user_data);
-                }
+    while (true) {
+        if (state->tokens) {
+            const char* token = ca_split_token(state);
+            if (token) {
+                *arg = token;
+                return 1;
             }
-        } else {
-            if (app.arg_callback) {
-                app.arg_callback(result.arg, user_data);
+            state->tokens = NULL;
+        }
+
+        if (state->next_arg >= state->argc) {
+            return 0;
+        }
+        const char* cur = state->argv[state->next_arg++];
+        state->arg_index = state->next_arg - 1;
+
+        // continue with the arguments in a response file
+        if (state->schema->use_response_files && !state->only_args
+            && cur[0] == '@' && cur[1] != '\0') {
+            if (ca_response_open(state, cur + 1) != 0) {
+                ca_report_error(state, CA_ERROR_FILE, CA_NO_OPT,
+                    state->arg_index, "cannot read response file %s: %s\n",
+                    cur + 1, strerror(errno));
+                return -1;
             }
+            continue;
         }
+
+        *arg = cur;
+        return 1;
     }
+}
 
-    return 0;
+/** Counts a lookup for `state` that found `opt`, and returns `opt`. */
+static int ca_count_lookup(struct ca_parse_state* state, int opt) {
+    if (opt == CA_NO_OPT) {
+        ca_stat_add(state->memory, lookup_misses, 1);
+    } else {
+        ca_stat_add(state->memory, lookup_hits, 1);
+    }
+    return opt;
 }
 
-void ca_print_version() {
-    // print program and version number
-    printf("%s %d.%d.%d\n", app.program, app.ver_major, app.ver_minor,
-        app.ver_patch);
+/** Looks up the short option `flag` for `state`; see ca_lookup_opt(). */
+static int ca_state_lookup_short(struct ca_parse_state* state, char flag) {
+    ca_stat_add(state->memory, short_lookups, 1);
+    return ca_count_lookup(state, ca_lookup_opt(state->schema, flag, NULL));
+}
 
-    // rest of the prints use authors
-    if (app.authors_length == 0) {
-        return;
+int ca_state_lookup_long(struct ca_parse_state* state, const char* name,
+    size_t length) {
+    ca_stat_add(state->memory, long_lookups, 1);
+    return ca_count_lookup(state,
+        ca_lookup_long_opt(state->schema, name, length));
+}
+
+/**
+ * Whether every flag in the null-terminated `flags` is a multiflag, decided
+ * from their bits alone without looking up any option.
+ */
+static bool ca_is_multiflag_cluster(const struct ca_schema* schema,
+    const char* flags) {
+    uint64_t mask = 0;
+    for (size_t i = 0; flags[i]; i++) {
+        int index = ca_short_opt_index(flags[i]);
+        if (index == CA_NO_OPT) {
+            return false;
+        }
+        mask |= (uint64_t)1 << index;
     }
+    return (mask & ~schema->mflag_mask) == 0;
+}
 
-    // print copyright
-    printf("\nCopyright (C) ");
-    // if no year is specified, do not print any
-    // if one is specified, compare with current year
-    // if they are the same, just print one year
-    // if they are different, print them both separated with a dash
-    if (app.year != CA_NO_YEAR) {
-        int current_year = ca_get_current_year();
-        if (current_year == CA_NO_YEAR) {
-            printf("%d ", app.year);
-        } else if (app.year == current_year) {
-            printf("%d ", app.year);
-        } else {
-            printf("%d-%d ", app.year, current_year);
+/**
+ * Reports the first flag in `flags`, which follow the multiflag `first`, that
+ * is unknown or not a multiflag, or every one if the parse goes on.
+ */
+static void ca_report_cluster_error(struct ca_parse_state* state,
+    const char* flags, char first) {
+    for (size_t i = 0; flags[i] && !state->halted; i++) {
+        int opt = ca_state_lookup_short(state, flags[i]);
+        if (opt == CA_NO_OPT) {
+            ca_report_error(state, CA_ERROR_UNKNOWN_OPT, CA_NO_OPT,
+                state->arg_index, "unknown flag -%c\n", flags[i]);
+        } else if (!(state->schema->hot[opt].flags & CA_OPT_MFLAG)) {
+            ca_report_error(state, CA_ERROR_NOT_MULTIFLAG, opt,
+                state->arg_index, "-%c must be passed separately from -%c\n",
+                flags[i], first);
         }
     }
-    print_authors();
-    printf(".");
+}
+
+int ca_state_next(struct ca_parse_state* state,
+    struct ca_parse_result* result) {
+    const struct ca_schema* schema = state->schema;
+
+    // a failed parse yields nothing more, unless it goes on to collect
+    // diagnostics
+    if (state->halted) {
+        return -1;
+    }
 
-    // print additional versioning information
-    if (app.ver_info) {
-        printf(" %s", app.ver_info);
+    // nor does one that --help, --version, or a subcommand ended
+    if (state->exit != CA_EXIT_NONE || state->subcommand != CA_NO_OPT) {
+        return 0;
     }
 
-    // print authorship
-    printf("\n\nWritten by ");
-    print_authors();
-    printf(".\n");
+    while (true) {
+        // finish a multiflag argument, which was checked as a whole already
+        if (state->cluster) {
+            char flag = *state->cluster++;
+            if (flag != '\0') {
+                return ca_yield_opt(state, ca_state_lookup_short(state, flag),
+                    NULL, state->arg_index, result);
+            }
+            state->cluster = NULL;
+        }
+
+        const char* cur;
+        int read = ca_read_arg(state, &cur);
+        if (read < 0) {
+            return -1;
+        }
+
+        // at the end, an option can only be waiting for an optional argument,
+        // which it goes without
+        if (read == 0) {
+            if (ca_check_pending(state) != 0) {
+                return -1;
+            }
+            if (state->pending_opt != CA_NO_OPT) {
+                int opt = state->pending_opt;
+                state->pending_opt = CA_NO_OPT;
+                return ca_yield_opt(state, opt, NULL, state->pending_index,
+                    result);
+            }
+            return 0;
+        }
+
+        // the first ordinary argument may name a subcommand, which parses
+        // the rest of the command line itself; it has to be in argv for that
+        if (!state->only_args && !state->had_arg && cur[0] != '-'
+            && state->pending_opt == CA_NO_OPT
+            && schema->subcommands_length > 0
+            && cur == state->argv[state->next_arg - 1]) {
+            int subcommand = ca_lookup_subcommand(schema, cur);
+            if (subcommand != CA_NO_OPT) {
+                state->subcommand = subcommand;
+                state->subcommand_arg = state->next_arg - 1;
+                return 0;
+            }
+        }
+
+        // when -- is passed and support for it is enabled, all subsequent
+        // arguments are treated only as arguments
+        if (state->only_args || cur[0] != '-') {
+            return ca_yield_arg(state, cur, result);
+        }
+
+        // it could be a flag
+
+        // handle '-' (common for stdin)
+        if (cur[1] == '\0') {
+            return ca_yield_arg(state, cur, result);
+        }
+
+        // handle '--'
+        if (strcmp(cur, "--") == 0) {
+            if (!schema->use_end_of_options) {
+                return ca_yield_arg(state, cur, result);
+            }
+            state->only_args = true;
+            continue;
+        }
+
+        // if an option is still pending, we're at a flag now, so it better
+        // have needed an _optional_ argument, which it goes without; either
+        // way, the flag is parsed next
+        if (ca_check_pending(state) != 0) {
+            state->held_arg = cur;
+            return -1;
+        }
+        if (state->pending_opt != CA_NO_OPT) {
+            int opt = state->pending_opt;
+            state->pending_opt = CA_NO_OPT;
+            state->held_arg = cur;
+            return ca_yield_opt(state, opt, NULL, state->pending_index,
+                result);
+        }
+
+        // we now parse the option and argument (if there)
+        int opt = CA_NO_OPT;
+        const char* arg = NULL;
+
+        // determine whether it is a long or short option and search for the
+        // corresponding option struct
+        if (cur[1] != '-' /* short opt */) {
+            char flag = cur[1];
+
+            // the first character after '-' should always be a valid option
+            opt = ca_state_lookup_short(state, flag);
+            if (opt == CA_NO_OPT) {
+                ca_report_error(state, CA_ERROR_UNKNOWN_OPT, CA_NO_OPT,
+                    state->arg_index, "unknown flag -%c\n", flag);
+                return -1;
+            }
+
+            // we might have more characters though
+            if (cur[2] != '\0') {
+                // we have a bunch of flags potentially after a short opt
+                // can only be multiflag if first is multiflag and then all
+                // others are too
+                if (schema->hot[opt].flags & CA_OPT_MFLAG) {
+                    if (!ca_is_multiflag_cluster(schema, cur + 2)) {
+                        ca_report_cluster_error(state, cur + 2, flag);
+                        return -1;
+                    }
+                    // yield the flags one at a time, starting with the one
+                    // already looked up
+                    state->cluster = cur + 2;
+                    return ca_yield_opt(state, opt, NULL, state->arg_index,
+                        result);
+                } else {
+                    // treat as connected option
+                    // example: -I/usr/include is -I /usr/include
+                    if (!(schema->hot[opt].flags & CA_OPT_ARG)) {
+                        ca_report_error(state, CA_ERROR_UNEXPECTED_ARG, opt,
+                            state->arg_index, "-%c does not take arguments\n",
+                            flag);
+                        return -1;
+                    }
+                    arg = cur + 2;
+                }
+            }
+        } else /* long opt */ {
+            // the name ends at an '=', after which is the argument, which is
+            // used in place
+            const char* name = cur + 2;
+            const char* equals = strchr(name, '=');
+            size_t length = equals ? (size_t)(equals - name) : strlen(name);
+            opt = ca_state_lookup_long(state, name, length);
+
+            // the hidden --ca-man ends the parse like --help
+            if (opt == CA_NO_OPT && schema->use_man_option && !equals
+                && strcmp(name, "ca-man") == 0) {
+                state->exit = CA_EXIT_MAN;
+                return 0;
+            }
+
+            // the hidden --ca-complete takes the rest of the command line as
+            // the words to complete, which are not parsed
+            if (opt == CA_NO_OPT && schema->use_complete_option && !equals
+                && strcmp(name, "ca-complete") == 0
+                && cur == state->argv[state->next_arg - 1]) {
+                state->exit = CA_EXIT_COMPLETE;
+                state->complete_arg = state->next_arg;
+                return 0;
+            }
+            if (opt == CA_NO_OPT) {
+                ca_report_error(state, CA_ERROR_UNKNOWN_OPT, CA_NO_OPT,
+                    state->arg_index, "unknown flag --%.*s\n", (int)length,
+                    name);
+                return -1;
+            }
+            if (equals) {
+                if (!(schema->hot[opt].flags & CA_OPT_ARG)) {
+                    ca_report_error(state, CA_ERROR_UNEXPECTED_ARG, opt,
+                        state->arg_index, "--%s does not take arguments\n",
+                        schema->options[opt].long_opt);
+                    return -1;
+                }
+                arg = equals + 1;
+            }
+        }
+        if (!arg && schema->hot[opt].flags & CA_OPT_ARG) {
+            // delay resolution of argument until the next one or the end
+            state->pending_opt = opt;
+            state->pending_index = state->arg_index;
+            continue;
+        }
+        return ca_yield_opt(state, opt, arg, state->arg_index, result);
+    }
 }
 
-void ca_print_help() {
-    // keep track of whether a section has been printed so extra space can be
-    // added for separation
-    bool previous_print = false;
+int ca_state_fill(struct ca_parse_state* state, int opt, const char* arg,
+    size_t earlier) {
+    const struct ca_schema* schema = state->schema;
+    if (opt == CA_NO_OPT || ca_opt_exit(schema, opt) != CA_EXIT_NONE) {
+        return 0;
+    }
 
-    // print description
-    if (app.description) {
-        printf("%s\n", app.description);
-        previous_print = true;
+    // whatever passed the option first takes precedence
+    if (state->was_passed[opt]) {
+        size_t i = earlier;
+        while (i < state->passed_length && state->passed[i] != opt) {
+            i++;
+        }
+        if (i == state->passed_length) {
+            return 0;
+        }
     }
 
-    // print synopses
-    if (app.synopses_length > 0) {
-        if (previous_print) printf("\n");
-        printf("Usage: %s %s\n", app.program, app.synopses[0]);
-        for (size_t i = 1; i < app.synopses_length; i++) {
-            printf("   or: %s %s\n", app.program, app.synopses[i]);
+    uint8_t flags = schema->hot[opt].flags;
+    if (!(flags & CA_OPT_ARG)) {
+        if (arg && (arg[0] == '\0' || strcmp(arg, "0") == 0)) {
+            return 0;
         }
-        previous_print = true;
+        arg = NULL;
+    } else if (!arg && !(flags & CA_OPT_OPTARG)) {
+        ca_report_error(state, CA_ERROR_MISSING_ARG, opt, -1,
+            "--%s missing required argument\n", schema->options[opt].long_opt);
+        return 1;
+    } else if (arg && arg[0] == '\0' && flags & CA_OPT_OPTARG) {
+        arg = NULL;
     }
 
-    // print options
-    if (app.options_length > 0) {
-        if (previous_print) printf("\n");
-        printf("Options:\n");
-        for (size_t i = 0; i < app.options_length; i++) {
-            const struct ca_opt* opt = &app.options[i];
+    struct ca_parse_result result;
+    return ca_yield_opt(state, opt, arg, -1, &result) < 0
+           || ca_push_result(state, result) != 0;
+}
 
-            // print the short option
-            if (opt->short_opt != '\0') {
-                printf(" -%c, ", opt->short_opt);
-            } else {
-                printf("      ");
+int ca_construct_results(struct ca_parse_state* state) {
+    ca_stat_begin(start);
+    struct ca_parse_result result;
+    int status;
+    while ((status = ca_state_next(state, &result)) != 0) {
+        // a parse collecting diagnostics goes on past each error it can
+        if (status < 0) {
+            if (state->halted) {
+                break;
             }
+            continue;
+        }
+        if (ca_push_result(state, result) != 0) {
+            break;
+        }
+    }
+
+    // what the command line left unset comes from the fallbacks, unless it
+    // already ended the parse
+    if (!state->halted && state->exit == CA_EXIT_NONE) {
+        (void)ca_state_fill_fallbacks(state);
+    }
+    ca_stat_end(state->memory, construct_ns, start);
+    return state->error != CA_ERROR_NONE;
+}
+
+/**
+ * The index in `argv` of the argument that first passed the option `opt` in
+ * the most recent parse into `state`, or -1 if it did not come from `argv`.
+ */
+static int ca_passed_at(const struct ca_parse_state* state, int opt) {
+    for (size_t i = 0; i < state->results_length; i++) {
+        if (state->results[i].opt == opt) {
+            return state->results[i].arg_index;
+        }
+    }
+    return -1;
+}
+
+/** See ca_verify_results(), which times this. */
+static int ca_check_results(struct ca_parse_state* state) {
+    const struct ca_schema* schema = state->schema;
+
+    // the rest of a command line that --help or --version ended is unknown
+    if (state->exit != CA_EXIT_NONE) {
+        return 0;
+    }
 
-            // print the long option with arg if necessary
-            int chars_printed = printf("--%s", opt->long_opt);
-            if (opt->flags & CA_OPT_ARG) {
-                chars_printed += printf("[=");
-                for (size_t j = 0; isalpha(opt->arg_name[j]); j++) {
-                    chars_printed += printf("%c", opt->arg_name[j]);
+    // check every distinct option passed; only the hot parts are needed unless
+    // there is a conflict to report
+    bool failed = false;
+    for (size_t i = 0; i < state->passed_length; i++) {
+        int index = state->passed[i];
+        const struct ca_opt_hot* opt = &schema->hot[index];
+        uint64_t passed_refs = state->passed_mask & opt->refs_mask;
+
+        // determine if the quantified proposition holds
+        bool verdict = false;
+        switch (opt->quantifier) {
+            case CA_OPT_QUANTIFIER_ANY: {
+                verdict = passed_refs != 0;
+                break;
+            }
+            case CA_OPT_QUANTIFIER_ALL: {
+                verdict = passed_refs == opt->refs_mask;
+                break;
+            }
+            case CA_OPT_QUANTIFIER_ONLY: {
+                // every passed option must be one of the refs
+                verdict = ca_count_bits(passed_refs) == state->passed_length;
+                break;
+            }
+            default: {
+                verdict = true;
+                break;
+            }
+        }
+        // negation flips verdict
+        if (opt->quantifier_is_negated) {
+            verdict = !verdict;
+        }
+        // render verdict
+        if (!verdict) {
+            int at = ca_passed_at(state, index);
+            switch (opt->quantifier) {
+                case CA_OPT_QUANTIFIER_ANY: {
+                    if (opt->quantifier_is_negated) {
+                        ca_report_error(state, CA_ERROR_CONFLICT, index, at,
+                            "-%c conflicts with --%s\n",
+                            ca_short_opt_at(ca_lowest_bit(passed_refs)),
+                            schema->options[index].long_opt);
+                    } else {
+                        ca_report_error(state, CA_ERROR_CONFLICT, index, at,
+                            "at least one of the specified options for "
+                            "--%s must be passed\n",
+                            schema->options[index].long_opt);
+                    }
+                    break;
+                }
+                case CA_OPT_QUANTIFIER_ALL: {
+                    if (opt->quantifier_is_negated) {
+                        ca_report_error(state, CA_ERROR_CONFLICT, index, at,
+                            "only some of the specified options for --%s "
+                            "should be passed\n",
+                            schema->options[index].long_opt);
+                    } else {
+                        ca_report_error(state, CA_ERROR_CONFLICT, index, at,
+                            "all of the specified options for --%s must be "
+                            "passed\n",
+                            schema->options[index].long_opt);
+                    }
+                    break;
                 }
-                chars_printed += printf("]");
+                case CA_OPT_QUANTIFIER_ONLY: {
+                    if (opt->quantifier_is_negated) {
+                        ca_report_error(state, CA_ERROR_CONFLICT, index, at,
+                            "only other options besides those specified "
+                            "for --%s should be passed\n",
+                            schema->options[index].long_opt);
+                    } else {
+                        if (opt->short_opt != '\0'
+                            && opt->refs_mask
+                                   == ca_short_opt_bit(opt->short_opt)) {
+                            ca_report_error(state, CA_ERROR_CONFLICT, index, at,
+                                "--%s must be passed by itself\n",
+                                schema->options[index].long_opt);
+                        } else {
+                            ca_report_error(state, CA_ERROR_CONFLICT, index, at,
+                                "--%s can only be passed with allowed "
+                                "options\n",
+                                schema->options[index].long_opt);
+                        }
+                    }
+                    break;
+                }
+                default:
+                    break;
             }
-
-            // determine if past the offset for printing descriptions
-            // if it is, put description on new line
-            // otherwise print description afterward
-            int padding = CA_DESCRIPTION_OFFSET
-                          - (chars_printed + (sizeof("      ") - 1));
-            if (padding < 1 /* min of 1 prevents right next to each other */) {
-                printf("\n%*s%s\n", CA_DESCRIPTION_OFFSET - 1, "",
-                    opt->description);
-            } else {
-                printf("%*s%s\n", padding, "", opt->description);
+            failed = true;
+            if (state->halted) {
+                return 1;
             }
         }
-        previous_print = true;
     }
+
+    return failed;
 }
 
-void ca_print_error(const char* fmt, ...) {
-    const char* prefix = "error";
-#ifdef CA_ON_UNIX
-    if (getenv("NO_COLOR") == NULL && isatty(fileno(stderr))) {
-        prefix = "\033[31merror\033[m";
+int ca_verify_results(struct ca_parse_state* state) {
+    ca_stat_begin(start);
+    int status = ca_check_results(state);
+    ca_stat_end(state->memory, verify_ns, start);
+    return status;
+}
+
+struct ca_app;
+static void ca_print_exit(struct ca_app* ctx,
+    const struct ca_parse_state* state);
+static int ca_ctx_run_subcommand(struct ca_app* ctx, void* user_data);
+static int ca_ctx_parse_argv(struct ca_app* ctx, void* user_data);
+
+/**
+ * Grows the per-option arrays of `state` to `capacity` entries, clearing the
+ * new ones. Sets `errno` on failure.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+static int ca_state_reserve_options(struct ca_parse_state* state,
+    size_t capacity) {
+    size_t old = state->options_capacity;
+#ifdef CA_STATIC_CAPACITY
+    if (capacity > CA_MAX_OPTIONS + 1) {
+        errno = ENOMEM;
+        return 1;
+    }
+    state->was_passed = state->was_passed_storage;
+    state->args = state->args_storage;
+    state->spans = state->spans_storage;
+#else
+    bool* was_passed = ca_memory_realloc(state->memory, state->was_passed,
+        sizeof(*was_passed) * old, sizeof(*was_passed) * capacity);
+    if (!was_passed) {
+        errno = ENOMEM;
+        return 1;
+    }
+    state->was_passed = was_passed;
+    const char** args = ca_memory_realloc(state->memory, state->args,
+        sizeof(*args) * old, sizeof(*args) * capacity);
+    if (!args) {
+        errno = ENOMEM;
+        return 1;
     }
+    state->args = args;
+    struct ca_values_span* spans = ca_memory_realloc(state->memory,
+        state->spans, sizeof(*spans) * old, sizeof(*spans) * capacity);
+    if (!spans) {
+        errno = ENOMEM;
+        return 1;
+    }
+    state->spans = spans;
 #endif
-    fprintf(stderr, "%s: ", prefix);
-    va_list l;
-    va_start(l, fmt);
-    vfprintf(stderr, fmt, l);
-    va_end(l);
+    for (size_t i = old; i < capacity; i++) {
+        state->was_passed[i] = false;
+        state->args[i] = NULL;
+        state->spans[i].start = 0;
+        state->spans[i].count = 0;
+    }
+    state->options_capacity = capacity;
+    return 0;
+}
+
+int ca_state_reset(struct ca_parse_state* state, int argc,
+    const char* argv[]) {
+    const struct ca_schema* schema = state->schema;
+    state->error = CA_ERROR_NONE;
+    state->halted = false;
+    state->diagnostics_length = 0;
+
+    // ensure inputs are safe to use
+    if (!ca_check_arg_consistency(argc, argv)) {
+        state->error = CA_ERROR_INVALID;
+        state->halted = true;
+        errno = EINVAL;
+        return 1;
+    }
+    state->argc = argc;
+    state->argv = argv;
+
+    // reset only the options passed last time
+    for (size_t i = 0; i < state->passed_length; i++) {
+        state->was_passed[state->passed[i]] = false;
+        state->args[state->passed[i]] = NULL;
+        state->spans[state->passed[i]].count = 0;
+    }
+    state->passed_length = 0;
+    state->passed_mask = 0;
+
+    // options registered since the last parse need entries too
+    if (state->options_capacity < schema->options_length
+        && ca_state_reserve_options(state, schema->options_length) != 0) {
+        state->error = CA_ERROR_NO_MEMORY;
+        state->halted = true;
+        return 1;
+    }
+
+    // clear results array
+    state->results_length = 0;
+
+    // we start at 1 because argv[0] is the program name and it's useless here
+    state->next_arg = 1;
+    state->cluster = NULL;
+    state->only_args = false;
+    state->pending_opt = CA_NO_OPT;
+    state->arg_index = -1;
+    state->pending_index = -1;
+    state->held_arg = NULL;
+    state->exit = CA_EXIT_NONE;
+    state->had_arg = false;
+    state->subcommand = CA_NO_OPT;
+    state->subcommand_arg = 0;
+    state->complete_arg = 0;
+
+    // the arguments of the last parse are no longer needed
+    ca_response_close_all(state);
+
+    return 0;
+}
+
+/**
+ * Writes the argument of `result`, converted as checked when it was yielded,
+ * to where `opt` keeps it. An omitted optional argument clears a string but
+ * leaves a typed value alone.
+ */
+static void ca_publish_arg(const struct ca_opt* opt,
+    const struct ca_opt_hot* hot, struct ca_parse_result result) {
+    if (!(hot->flags & CA_OPT_ARG)) {
+        return;
+    }
+    if (opt->type == CA_VALUE_STRING) {
+        *(const char**)opt->result = result.arg;
+    } else if (result.arg) {
+        ca_parse_value(opt->type, result.arg, result.arg_length, opt->result);
+    }
+}
+
+/**
+ * Runs the callbacks for the results of the parse in `state`. The arguments
+ * to options are also written through their `result` pointers if `publish`
+ * is set.
+ */
+static void ca_state_dispatch(struct ca_parse_state* state, void* user_data,
+    bool publish) {
+    const struct ca_schema* schema = state->schema;
+    ca_stat_begin(start);
+    for (size_t i = 0; i < state->results_length; i++) {
+        struct ca_parse_result result = state->results[i];
+        if (result.opt != CA_NO_OPT) {
+            const struct ca_opt* opt = &schema->options[result.opt];
+            const struct ca_opt_hot* hot = &schema->hot[result.opt];
+            if (publish) {
+                ca_publish_arg(opt, hot, result);
+            }
+            if (opt->handler) {
+                opt->handler(result.arg, opt->handler_data);
+                ca_stat_add(state->memory, callbacks, 1);
+            } else if (schema->opt_callback) {
+                schema->opt_callback(hot->short_opt, opt->long_opt,
+                    result.arg, user_data);
+                ca_stat_add(state->memory, callbacks, 1);
+            }
+        } else {
+            if (schema->arg_callback) {
+                schema->arg_callback(result.arg, user_data);
+                ca_stat_add(state->memory, callbacks, 1);
+            }
+        }
+    }
+    ca_stat_end(state->memory, callback_ns, start);
+}
+
+/**
+ * Gathers the arguments of each option that accumulates them into one array,
+ * sized by counting them first. Returns zero on success, nonzero otherwise.
+ */
+static int ca_collect_values(struct ca_parse_state* state) {
+    const struct ca_schema* schema = state->schema;
+
+    // count, so that there is at most one allocation however many there are
+    size_t total = 0;
+    for (size_t i = 0; i < state->results_length; i++) {
+        struct ca_parse_result result = state->results[i];
+        if (result.opt != CA_NO_OPT && result.arg
+            && schema->hot[result.opt].flags & CA_OPT_MANY) {
+            state->spans[result.opt].count++;
+            total++;
+        }
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+#ifdef CA_STATIC_CAPACITY
+    // there are never more values than results
+    state->values = state->values_storage;
+#else
+    if (state->values_capacity < total) {
+        const char** values = ca_memory_realloc(state->memory, state->values,
+            sizeof(*values) * state->values_capacity,
+            sizeof(*values) * total);
+        if (!values) {
+            ca_report_error(state, CA_ERROR_NO_MEMORY, CA_NO_OPT, -1,
+                "out of memory\n");
+            return 1;
+        }
+        state->values = values;
+        state->values_capacity = total;
+    }
+#endif
+
+    // lay the options out in order of first occurrence, and then fill them
+    size_t start = 0;
+    for (size_t i = 0; i < state->passed_length; i++) {
+        struct ca_values_span* span = &state->spans[state->passed[i]];
+        span->start = start;
+        start += span->count;
+        span->count = 0;
+    }
+    for (size_t i = 0; i < state->results_length; i++) {
+        struct ca_parse_result result = state->results[i];
+        if (result.opt != CA_NO_OPT && result.arg
+            && schema->hot[result.opt].flags & CA_OPT_MANY) {
+            struct ca_values_span* span = &state->spans[result.opt];
+            state->values[span->start + span->count++] = result.arg;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Parses the command line `state` was readied with, and then runs the
+ * callbacks as in ca_state_dispatch(), publishing the results if `state` is
+ * that of `ctx`, which is otherwise `NULL`. Returns zero on success, nonzero
+ * otherwise.
+ */
+static int ca_state_run(struct ca_parse_state* state, struct ca_app* ctx,
+    void* user_data) {
+    // do bulk of the parsing
+    int failed = ca_construct_results(state);
+    if (state->halted) {
+        return 1;
+    }
+
+    // --help and --version are answered without looking further
+    if (state->exit != CA_EXIT_NONE && !failed) {
+        ca_print_exit(ctx, state);
+        return 0;
+    }
+
+    // check for conflicts, even after other errors if the parse went on past
+    // them
+    if (ca_verify_results(state) != 0 || failed) {
+        return 1;
+    }
+
+    if (ca_collect_values(state) != 0) {
+        return 1;
+    }
+
+    // run the callbacks
+    ca_state_dispatch(state, user_data, ctx != NULL);
+
+    // a state without a context has nowhere to register a subcommand, so it
+    // only notes which one was selected
+    if (ctx && state->subcommand != CA_NO_OPT) {
+        return ca_ctx_run_subcommand(ctx, user_data);
+    }
+
+    return 0;
+}
+
+/**
+ * Copies `line`, which is `length` bytes long, into `state` to be split into
+ * arguments. Sets `errno` on failure.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+static int ca_state_load_line(struct ca_parse_state* state, const char* line,
+    size_t length) {
+#ifdef CA_STATIC_CAPACITY
+    if (length + 1 > CA_MAX_LINE) {
+        state->error = CA_ERROR_NO_MEMORY;
+        errno = ENOMEM;
+        return 1;
+    }
+    state->line = state->line_storage;
+#else
+    // the copy is reused from line to line
+    if (state->line_capacity < length + 1) {
+        char* copy = ca_memory_realloc(state->memory, state->line,
+            state->line_capacity, length + 1);
+        if (!copy) {
+            state->error = CA_ERROR_NO_MEMORY;
+            errno = ENOMEM;
+            return 1;
+        }
+        state->line = copy;
+        state->line_capacity = length + 1;
+    }
+#endif
+    memcpy(state->line, line, length);
+    state->line[length] = '\0';
+    state->tokens = state->line;
+    state->tokens_end = state->line + length;
+    return 0;
+}
+
+/**
+ * Readies `state` to parse `line` as if it followed the program name on the
+ * command line. Returns zero on success, nonzero otherwise.
+ */
+static int ca_state_reset_line(struct ca_parse_state* state, const char* line,
+    size_t length) {
+    if (!line && length > 0) {
+        state->error = CA_ERROR_INVALID;
+        errno = EINVAL;
+        return 1;
+    }
+    state->line_argv[0] = state->schema->program;
+    state->line_argv[1] = NULL;
+    if (ca_state_reset(state, 1, state->line_argv) != 0) {
+        return 1;
+    }
+    return ca_state_load_line(state, line, length);
+}
+
+/**
+ * Makes the context of the subcommand at `index` in `ctx` for the command
+ * line `argc` and `argv`, which starts with its name, and registers its
+ * options. It is kept as the subcommand context of `ctx`.
+ *
+ * @returns The context, or `NULL` if there is no memory for it.
+ */
+static struct ca_app* ca_ctx_enter_subcommand(struct ca_app* ctx, int index,
+    int argc, const char** argv) {
+    const struct ca_schema* schema = &ctx->schema;
+    const struct ca_subcommand* subcommand = &schema->subcommands[index];
+
+    struct ca_app* sub = ca_ctx_new(argc, argv);
+    if (!sub) {
+        return NULL;
+    }
+    ctx->sub = sub;
+
+    // the subcommand is part of the same program
+    sub->schema.program = schema->program;
+    sub->schema.year = schema->year;
+    sub->schema.ver_major = schema->ver_major;
+    sub->schema.ver_minor = schema->ver_minor;
+    sub->schema.ver_patch = schema->ver_patch;
+    sub->schema.ver_info = schema->ver_info;
+    for (size_t i = 0; i < schema->authors_length; i++) {
+        ca_ctx_author(sub, schema->authors[i]);
+    }
+    sub->schema.use_end_of_options = schema->use_end_of_options;
+    sub->schema.use_response_files = schema->use_response_files;
+    sub->schema.use_man_option = schema->use_man_option;
+    sub->schema.use_complete_option = schema->use_complete_option;
+    sub->schema.env_prefix = schema->env_prefix;
+    sub->schema.config_path = schema->config_path;
+
+    subcommand->register_fn(sub, subcommand->data);
+    return sub;
+}
+
+/**
+ * Parses the rest of the command line of `ctx` with a new context for the
+ * subcommand that ended its parse. Returns zero on success, nonzero
+ * otherwise.
+ */
+static int ca_ctx_run_subcommand(struct ca_app* ctx, void* user_data) {
+    struct ca_parse_state* state = &ctx->state;
+    struct ca_app* sub = ca_ctx_enter_subcommand(ctx, state->subcommand,
+        state->argc - state->subcommand_arg,
+        state->argv + state->subcommand_arg);
+    if (!sub) {
+        state->error = CA_ERROR_NO_MEMORY;
+        return 1;
+    }
+    return ca_ctx_parse_argv(sub, user_data);
+}
+
+/**
+ * Appends `dashes` followed by `name` to `text` on a line of its own if
+ * together they begin with `word`.
+ */
+static void ca_offer_completion(struct ca_text* text, const char* dashes,
+    const char* name, const char* word) {
+    size_t dashes_length = strlen(dashes);
+    size_t word_length = strlen(word);
+    if (strncmp(word, dashes,
+            word_length < dashes_length ? word_length : dashes_length)
+            != 0
+        || (word_length > dashes_length
+            && strncmp(name, word + dashes_length,
+                   word_length - dashes_length)
+                   != 0)) {
+        return;
+    }
+    ca_text_puts(text, dashes);
+    ca_text_puts(text, name);
+    ca_text_append(text, "\n", 1);
+}
+
+/**
+ * Appends the words that can complete `word` to `text`, one per line, given
+ * the `length` words before it on the command line for `schema`, starting
+ * with the program name. A subcommand named along the way is registered into
+ * `ctx` to complete the rest, unless `ctx` is `NULL`.
+ */
+static void ca_complete_words(struct ca_app* ctx,
+    const struct ca_schema* schema, const char** words, size_t length,
+    const char* word, struct ca_text* text) {
+    // follow the words before as the parser would, to tell whether the word
+    // is an option, an argument to one, or an ordinary argument
+    bool only_args = false;
+    bool had_arg = false;
+    int pending = CA_NO_OPT;
+    for (size_t i = 1; i < length; i++) {
+        const char* cur = words[i];
+        if (!only_args && schema->use_end_of_options
+            && strcmp(cur, "--") == 0) {
+            only_args = true;
+            continue;
+        }
+        if (only_args || cur[0] != '-' || cur[1] == '\0'
+            || strcmp(cur, "--") == 0) {
+            if (pending != CA_NO_OPT) {
+                pending = CA_NO_OPT;
+                continue;
+            }
+            int subcommand = !had_arg && cur[0] != '-' && ctx
+                                 ? ca_lookup_subcommand(schema, cur)
+                                 : CA_NO_OPT;
+            if (subcommand != CA_NO_OPT) {
+                struct ca_app* sub = ca_ctx_enter_subcommand(ctx, subcommand,
+                    (int)(length - i), words + i);
+                if (sub && ca_ctx_freeze(sub) == 0) {
+                    ca_complete_words(sub, &sub->schema, words + i,
+                        length - i, word, text);
+                }
+                return;
+            }
+            had_arg = true;
+            continue;
+        }
+
+        // an option waits for the next word only if its argument is not
+        // connected to it
+        int opt = CA_NO_OPT;
+        if (cur[1] == '-') {
+            if (!strchr(cur + 2, '=')) {
+                opt = ca_lookup_long_opt(schema, cur + 2, strlen(cur + 2));
+            }
+        } else if (cur[2] == '\0') {
+            opt = ca_lookup_opt(schema, cur[1], NULL);
+        }
+        pending = opt != CA_NO_OPT && schema->hot[opt].flags & CA_OPT_ARG
+                      ? opt
+                      : CA_NO_OPT;
+    }
+
+    // an argument is left to the shell, and so is a word that may be an
+    // optional one
+    bool is_opt = !only_args && word[0] == '-';
+    if (pending != CA_NO_OPT
+        && (!(schema->hot[pending].flags & CA_OPT_OPTARG) || !is_opt)) {
+        return;
+    }
+
+    if (is_opt) {
+        for (size_t i = 0; i < schema->options_length; i++) {
+            char short_opt[] = {schema->hot[i].short_opt, '\0'};
+            if (short_opt[0] != '\0') {
+                ca_offer_completion(text, "-", short_opt, word);
+            }
+            ca_offer_completion(text, "--", schema->options[i].long_opt,
+                word);
+        }
+    } else if (!only_args && !had_arg) {
+        for (size_t i = 0; i < schema->subcommands_length; i++) {
+            ca_offer_completion(text, "", schema->subcommands[i].name, word);
+        }
+    }
+}
+
+/**
+ * Prints the words that complete the command line after the `--ca-complete`
+ * that ended the parse in `state`, registering subcommands into `ctx` if it
+ * is non-`NULL`; see ca_use_complete_option().
+ */
+static void ca_print_completions(struct ca_app* ctx,
+    const struct ca_parse_state* state) {
+    // the index comes first, and the word there may be past the end
+    int first = state->complete_arg;
+    if (first >= state->argc) {
+        return;
+    }
+    char* end;
+    errno = 0;
+    long index = strtol(state->argv[first], &end, 10);
+    if (end == state->argv[first] || *end != '\0' || errno != 0
+        || index < 1) {
+        return;
+    }
+    const char** words = state->argv + first + 1;
+    size_t count = (size_t)(state->argc - first - 1);
+    size_t length = (size_t)index < count ? (size_t)index : count;
+    const char* word = (size_t)index < count ? words[index] : "";
+
+    char buffer[512];
+    struct ca_text text;
+    ca_text_init(&text, buffer, sizeof(buffer), stdout);
+    ca_complete_words(ctx, state->schema, words, length, word, &text);
+    ca_text_flush(&text);
+}
+
+/** Releases the subcommand context of the previous parse of `ctx`. */
+static void ca_ctx_drop_subcommand(struct ca_app* ctx) {
+    ca_ctx_free(ctx->sub);
+    ctx->sub = NULL;
+}
+
+/** Parses the command line of `ctx`; see ca_ctx_parse(), which wraps this. */
+static int ca_ctx_parse_argv(struct ca_app* ctx, void* user_data) {
+    // build the lookup tables if registration changed them
+    if (ca_ctx_freeze(ctx) != 0) {
+        return 1;
+    }
+    ca_ctx_drop_subcommand(ctx);
+
+    if (ca_state_reset(&ctx->state, ctx->argc, ctx->argv) != 0) {
+        return 1;
+    }
+    return ca_state_run(&ctx->state, ctx, user_data);
+}
+
+int ca_ctx_parse(struct ca_app* ctx, void* user_data) {
+    int status = ca_ctx_parse_argv(ctx, user_data);
+
+    // the shell asking the program for completions reads nothing but them;
+    // every other parse leaves it to the caller to stop
+    if (status == 0 && ca_ctx_answered_completion(ctx)) {
+        exit(0);
+    }
+    return status;
+}
+
+int ca_ctx_reparse(struct ca_app* ctx, int argc, const char* argv[],
+    void* user_data) {
+    // the previous command line stays in place if this one is unusable
+    if (!ca_check_arg_consistency(argc, argv)) {
+        ctx->state.error = CA_ERROR_INVALID;
+        errno = EINVAL;
+        return 1;
+    }
+    ctx->argc = argc;
+    ctx->argv = argv;
+    return ca_ctx_parse_argv(ctx, user_data);
+}
+
+int ca_ctx_parse_line(struct ca_app* ctx, const char* line, size_t length,
+    void* user_data) {
+    if (ca_ctx_freeze(ctx) != 0) {
+        return 1;
+    }
+    ca_ctx_drop_subcommand(ctx);
+    if (ca_state_reset_line(&ctx->state, line, length) != 0) {
+        return 1;
+    }
+    return ca_state_run(&ctx->state, ctx, user_data);
+}
+
+void ca_ctx_collect_diagnostics(struct ca_app* ctx,
+    struct ca_diagnostic* buffer, size_t capacity) {
+    ca_state_collect_diagnostics(&ctx->state, buffer, capacity);
+}
+
+size_t ca_ctx_diagnostic_count(const struct ca_app* ctx) {
+    return ca_state_diagnostic_count(&ctx->state);
+}
+
+int ca_ctx_iter_begin(struct ca_app* ctx) {
+    if (ca_ctx_freeze(ctx) != 0) {
+        return 1;
+    }
+    ca_ctx_drop_subcommand(ctx);
+    return ca_state_reset(&ctx->state, ctx->argc, ctx->argv);
+}
+
+bool ca_ctx_next(struct ca_app* ctx, struct ca_item* item) {
+    const struct ca_schema* schema = &ctx->schema;
+    struct ca_parse_result result;
+    int status;
+    while ((status = ca_state_next(&ctx->state, &result)) < 0
+           && !ctx->state.halted) {}
+    if (status <= 0) {
+        return false;
+    }
+
+    item->handle = result.opt;
+    item->arg = result.arg;
+    item->arg_length = result.arg_length;
+    if (result.opt == CA_NO_OPT) {
+        item->short_opt = '\0';
+        item->long_opt = NULL;
+    } else {
+        const struct ca_opt* opt = &schema->options[result.opt];
+        item->short_opt = schema->hot[result.opt].short_opt;
+        item->long_opt = opt->long_opt;
+        ca_publish_arg(opt, &schema->hot[result.opt], result);
+    }
+    return true;
+}
+
+int ca_ctx_iter_finish(struct ca_app* ctx) {
+    struct ca_parse_state* state = &ctx->state;
+
+    // the checks need every option passed
+    struct ca_item item;
+    while (ca_ctx_next(ctx, &item)) {}
+    if (state->halted) {
+        return 1;
+    }
+    bool failed = state->error != CA_ERROR_NONE;
+    return ca_verify_results(state) != 0 || failed;
+}
+
+const struct ca_schema* ca_ctx_schema(struct ca_app* ctx) {
+    if (ca_ctx_freeze(ctx) != 0) {
+        return NULL;
+    }
+    return &ctx->schema;
+}
+
+struct ca_parse_state* ca_state_new(const struct ca_schema* schema) {
+    if (!schema || !schema->frozen) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct ca_memory memory;
+    ca_memory_init(&memory, false);
+
+    // zeroed so that a partial initialization can be released
+    struct ca_parse_state* state = ca_memory_alloc(&memory, sizeof(*state));
+    if (!state) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(state, 0, sizeof(*state));
+
+    // size the per-option arrays up front so parses do not have to, with one
+    // spare entry so that an empty schema still allocates
+    if (ca_state_init(state, schema, NULL) != 0
+        || ca_state_reserve_options(state, schema->options_length + 1) != 0) {
+        int error = errno;
+        ca_state_deinit(state);
+        ca_memory_free(&memory, state);
+        errno = error;
+        return NULL;
+    }
+
+    return state;
+}
+
+void ca_state_free(struct ca_parse_state* state) {
+    if (state) {
+        // `state` came from the same allocator as its arrays
+        struct ca_allocator allocator = state->own_memory.allocator;
+        ca_state_deinit(state);
+        allocator.free(state, allocator.user);
+    }
+}
+
+int ca_state_parse(struct ca_parse_state* state, int argc, const char* argv[],
+    void* user_data) {
+    if (!state->schema->frozen) {
+        state->error = CA_ERROR_INVALID;
+        errno = EINVAL;
+        return 1;
+    }
+    if (ca_state_reset(state, argc, argv) != 0) {
+        return 1;
+    }
+    return ca_state_run(state, NULL, user_data);
+}
+
+int ca_state_parse_line(struct ca_parse_state* state, const char* line,
+    size_t length, void* user_data) {
+    if (!state->schema->frozen) {
+        state->error = CA_ERROR_INVALID;
+        errno = EINVAL;
+        return 1;
+    }
+    if (ca_state_reset_line(state, line, length) != 0) {
+        return 1;
+    }
+    return ca_state_run(state, NULL, user_data);
+}
+
+enum ca_error ca_state_error(const struct ca_parse_state* state) {
+    return state->error;
+}
+
+bool ca_state_answered_completion(const struct ca_parse_state* state) {
+    return state->exit == CA_EXIT_COMPLETE;
+}
+
+void ca_state_collect_diagnostics(struct ca_parse_state* state,
+    struct ca_diagnostic* buffer, size_t capacity) {
+    state->diagnostics = buffer;
+    state->diagnostics_capacity = buffer ? capacity : 0;
+    state->diagnostics_length = 0;
+}
+
+size_t ca_state_diagnostic_count(const struct ca_parse_state* state) {
+    return state->diagnostics_length;
+}
+
+/**
+ * The arguments kept by `opt` in `state`, setting `*count` to how many there
+ * are.
+ */
+static const char* const* ca_state_values_of(
+    const struct ca_parse_state* state, int opt, size_t* count) {
+    if (opt == CA_NO_OPT || state->spans[opt].count == 0) {
+        *count = 0;
+        return NULL;
+    }
+    *count = state->spans[opt].count;
+    return state->values + state->spans[opt].start;
+}
+
+/**
+ * Whether `handle` names an option of the schema of `state` for which the
+ * most recent parse into `state` succeeded.
+ */
+static bool ca_state_has_result(const struct ca_parse_state* state,
+    int handle) {
+    return handle >= 0 && (size_t)handle < state->options_capacity
+           && (size_t)handle < state->schema->options_length
+           && state->error == CA_ERROR_NONE;
+}
+
+bool ca_state_was_passed(const struct ca_parse_state* state, int handle) {
+    return ca_state_has_result(state, handle) && state->was_passed[handle];
+}
+
+const char* ca_state_arg(const struct ca_parse_state* state, int handle) {
+    return ca_state_has_result(state, handle) ? state->args[handle] : NULL;
+}
+
+const char* const* ca_state_values(const struct ca_parse_state* state,
+    int handle, size_t* count) {
+    return ca_state_values_of(state,
+        ca_state_has_result(state, handle) ? handle : CA_NO_OPT, count);
+}
+
+/**
+ * Whether `handle` names an option of `ctx` for which the most recent
+ * ca_ctx_parse() succeeded.
+ */
+static bool ca_ctx_has_result(const struct ca_app* ctx, int handle) {
+    return ca_state_has_result(&ctx->state, handle);
+}
+
+bool ca_ctx_answered_completion(const struct ca_app* ctx) {
+    // completing into a subcommand enters it without parsing it, so the
+    // context that answered may sit anywhere along the chain
+    for (; ctx; ctx = ctx->sub) {
+        if (ca_state_answered_completion(&ctx->state)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ca_ctx_was_passed(const struct ca_app* ctx, int handle) {
+    return ca_ctx_has_result(ctx, handle) && ctx->state.was_passed[handle];
+}
+
+const char* ca_ctx_arg(const struct ca_app* ctx, int handle) {
+    return ca_ctx_has_result(ctx, handle) ? ctx->state.args[handle] : NULL;
+}
+
+const char* const* ca_ctx_values(const struct ca_app* ctx, int handle,
+    size_t* count) {
+    return ca_state_values_of(&ctx->state,
+        ca_ctx_has_result(ctx, handle) ? handle : CA_NO_OPT, count);
+}
+
+/** Prints versioning information for `schema`; see ca_print_version(). */
+static void ca_schema_print_version(const struct ca_schema* schema) {
+    // text given verbatim is written from where it is, never copied
+    if (schema->version_text) {
+        fwrite(schema->version_text, 1, schema->version_length, stdout);
+        return;
+    }
+    ca_print_text(schema, &schema->version_cache, ca_render_version_text);
+}
+
+/** Prints help information for `schema`; see ca_print_help(). */
+static void ca_schema_print_help(const struct ca_schema* schema) {
+    if (schema->help_text) {
+        fwrite(schema->help_text, 1, schema->help_length, stdout);
+        return;
+    }
+    ca_print_text(schema, &schema->help_cache, ca_render_help_text);
+}
+
+void ca_ctx_print_version(struct ca_app* ctx) {
+    // on failure, the text is laid out again as it is printed
+    if (!ctx->schema.version_text) {
+        (void)ca_cache_text(&ctx->schema, &ctx->schema.version_cache,
+            ca_render_version_text);
+    }
+    ca_schema_print_version(&ctx->schema);
+}
+
+void ca_ctx_print_help(struct ca_app* ctx) {
+    if (!ctx->schema.help_text) {
+        (void)ca_cache_text(&ctx->schema, &ctx->schema.help_cache,
+            ca_render_help_text);
+    }
+    ca_schema_print_help(&ctx->schema);
+}
+
+void ca_ctx_print_man(struct ca_app* ctx) {
+    ca_print_text(&ctx->schema, NULL, ca_render_man_text);
+}
+
+void ca_ctx_print_completion(struct ca_app* ctx, enum ca_shell shell) {
+    char buffer[512];
+    struct ca_text text;
+    ca_text_init(&text, buffer, sizeof(buffer), stdout);
+    ca_render_completion_text(&ctx->schema, shell, &text);
+    ca_text_flush(&text);
+}
+
+size_t ca_ctx_render_version(struct ca_app* ctx, char* buffer,
+    size_t capacity) {
+    // text given verbatim goes straight into `buffer`, without a cache
+    return ca_copy_text(&ctx->schema,
+        ctx->schema.version_text ? NULL : &ctx->schema.version_cache,
+        ca_render_version_text, buffer, capacity);
+}
+
+size_t ca_ctx_render_help(struct ca_app* ctx, char* buffer, size_t capacity) {
+    return ca_copy_text(&ctx->schema,
+        ctx->schema.help_text ? NULL : &ctx->schema.help_cache,
+        ca_render_help_text, buffer, capacity);
+}
+
+/**
+ * Prints the output of the `--help`, `--version`, or hidden option that ended
+ * the parse in `state`, caching it in `ctx` if `state` belongs to one.
+ */
+static void ca_print_exit(struct ca_app* ctx,
+    const struct ca_parse_state* state) {
+    switch (state->exit) {
+        case CA_EXIT_HELP:
+            if (ctx) {
+                ca_ctx_print_help(ctx);
+            } else {
+                ca_schema_print_help(state->schema);
+            }
+            break;
+        case CA_EXIT_VERSION:
+            if (ctx) {
+                ca_ctx_print_version(ctx);
+            } else {
+                ca_schema_print_version(state->schema);
+            }
+            break;
+        case CA_EXIT_MAN:
+            ca_print_text(state->schema, NULL, ca_render_man_text);
+            break;
+        case CA_EXIT_COMPLETE:
+            ca_print_completions(ctx, state);
+            break;
+        case CA_EXIT_NONE:
+            break;
+    }
+}
+
+#ifdef CA_ON_UNIX
+/** Whether errors are colored; see ca_detect_error_color(). */
+static bool ca_error_color = false;
+static pthread_once_t ca_error_color_once = PTHREAD_ONCE_INIT;
+
+/** Decides whether errors are colored, which they are on a terminal. */
+static void ca_detect_error_color(void) {
+    ca_error_color = getenv("NO_COLOR") == NULL && isatty(fileno(stderr));
+}
+#endif
+
+static void ca_write_error(const char* fmt, va_list args) {
+    // the terminal is checked once per process rather than once per error
+    const char* prefix = "error: ";
+#ifdef CA_ON_UNIX
+    pthread_once(&ca_error_color_once, ca_detect_error_color);
+    if (ca_error_color) {
+        prefix = "\033[31merror\033[m: ";
+    }
+#endif
+
+    // the message is formatted first so that stderr is locked only once
+    char buffer[512];
+    size_t length = strlen(prefix);
+    memcpy(buffer, prefix, length);
+    va_list copy;
+    va_copy(copy, args);
+    int written = vsnprintf(buffer + length, sizeof(buffer) - length, fmt,
+        copy);
+    va_end(copy);
+    if (written >= 0 && (size_t)written < sizeof(buffer) - length) {
+        fwrite(buffer, 1, length + (size_t)written, stderr);
+    } else {
+        fputs(prefix, stderr);
+        vfprintf(stderr, fmt, args);
+    }
+}
+
+void ca_vprint_error(const char* fmt, va_list args) {
+    ca_write_error(fmt, args);
+}
+
+void ca_print_error(const char* fmt, ...) {
+    va_list l;
+    va_start(l, fmt);
+    ca_vprint_error(fmt, l);
+    va_end(l);
+}
+
+int ca_init(int argc, const char* argv[]) {
+    if (ca_ctx_init(&app, argc, argv) != 0) {
+        return 1;
+    }
+
+    // register deinitialization on program exit
+    atexit(ca_deinit);
+
+    return 0;
+}
+
+void ca_deinit(void) {
+    ca_ctx_deinit(&app);
+}
+
+void ca_description(const char* description) {
+    ca_ctx_description(&app, description);
+}
+
+void ca_author(const char* author) {
+    ca_ctx_author(&app, author);
+}
+
+void ca_year(int year) {
+    ca_ctx_year(&app, year);
+}
+
+void ca_version(int major, int minor, int patch) {
+    ca_ctx_version(&app, major, minor, patch);
+}
+
+void ca_versioning_info(const char* info) {
+    ca_ctx_versioning_info(&app, info);
+}
+
+void ca_synopsis(const char* synopsis) {
+    ca_ctx_synopsis(&app, synopsis);
+}
+
+void ca_use_end_of_options(bool use) {
+    ca_ctx_use_end_of_options(&app, use);
+}
+
+void ca_use_man_option(bool use) {
+    ca_ctx_use_man_option(&app, use);
+}
+
+void ca_use_complete_option(bool use) {
+    ca_ctx_use_complete_option(&app, use);
+}
+
+void ca_use_response_files(bool use) {
+    ca_ctx_use_response_files(&app, use);
+}
+
+void ca_env_prefix(const char* prefix) {
+    ca_ctx_env_prefix(&app, prefix);
+}
+
+void ca_config_file(const char* path) {
+    ca_ctx_config_file(&app, path);
+}
+
+void ca_override_help_version(bool override_help, bool override_version) {
+    ca_ctx_override_help_version(&app, override_help, override_version);
+}
+
+void ca_set_help_text(const char* text, size_t length) {
+    ca_ctx_set_help_text(&app, text, length);
+}
+
+void ca_set_version_text(const char* text, size_t length) {
+    ca_ctx_set_version_text(&app, text, length);
+}
+
+int ca_opt(char short_opt, const char* long_opt, const char* behavior,
+    const char** result, const char* description) {
+    return ca_ctx_opt(&app, short_opt, long_opt, behavior, result,
+        description);
+}
+
+int ca_long_opt(const char* long_opt, const char* behavior,
+    const char** result, const char* description) {
+    return ca_ctx_long_opt(&app, long_opt, behavior, result, description);
+}
+
+int ca_opts(const struct ca_opt_spec* specs, size_t count) {
+    return ca_ctx_opts(&app, specs, count);
+}
+
+int ca_freeze(void) {
+    return ca_ctx_freeze(&app);
+}
+
+void ca_set_callbacks(void (*opt_callback)(char, const char*, const char*,
+                          void*),
+    void (*arg_callback)(const char*, void*)) {
+    ca_ctx_set_callbacks(&app, opt_callback, arg_callback);
+}
+
+int ca_subcommand(const char* name, const char* description,
+    void (*register_fn)(struct ca_app* ctx, void* data), void* data) {
+    return ca_ctx_subcommand(&app, name, description, register_fn, data);
+}
+
+int ca_selected_subcommand(void) {
+    return ca_ctx_selected_subcommand(&app);
+}
+
+struct ca_app* ca_subcommand_context(void) {
+    return ca_ctx_subcommand_context(&app);
+}
+
+int ca_set_handler(int handle, void (*handler)(const char* arg, void* data),
+    void* data) {
+    return ca_ctx_set_handler(&app, handle, handler, data);
+}
+
+int ca_parse(void* user_data) {
+    return ca_ctx_parse(&app, user_data);
+}
+
+int ca_reparse(int argc, const char* argv[], void* user_data) {
+    return ca_ctx_reparse(&app, argc, argv, user_data);
+}
+
+int ca_parse_line(const char* line, size_t length, void* user_data) {
+    return ca_ctx_parse_line(&app, line, length, user_data);
+}
+
+void ca_collect_diagnostics(struct ca_diagnostic* buffer, size_t capacity) {
+    ca_ctx_collect_diagnostics(&app, buffer, capacity);
+}
+
+size_t ca_diagnostic_count(void) {
+    return ca_ctx_diagnostic_count(&app);
+}
+
+int ca_iter_begin(void) {
+    return ca_ctx_iter_begin(&app);
+}
+
+bool ca_next(struct ca_item* item) {
+    return ca_ctx_next(&app, item);
+}
+
+int ca_iter_finish(void) {
+    return ca_ctx_iter_finish(&app);
+}
+
+bool ca_was_passed(int handle) {
+    return ca_ctx_was_passed(&app, handle);
+}
+
+const char* ca_arg(int handle) {
+    return ca_ctx_arg(&app, handle);
+}
+
+int ca_opt_int(char short_opt, const char* long_opt, const char* behavior,
+    int* result, const char* description) {
+    return ca_ctx_opt_int(&app, short_opt, long_opt, behavior, result,
+        description);
+}
+
+int ca_opt_u64(char short_opt, const char* long_opt, const char* behavior,
+    uint64_t* result, const char* description) {
+    return ca_ctx_opt_u64(&app, short_opt, long_opt, behavior, result,
+        description);
+}
+
+int ca_opt_double(char short_opt, const char* long_opt, const char* behavior,
+    double* result, const char* description) {
+    return ca_ctx_opt_double(&app, short_opt, long_opt, behavior, result,
+        description);
+}
+
+int ca_opt_size(char short_opt, const char* long_opt, const char* behavior,
+    size_t* result, const char* description) {
+    return ca_ctx_opt_size(&app, short_opt, long_opt, behavior, result,
+        description);
+}
+
+const char* const* ca_values(int handle, size_t* count) {
+    return ca_ctx_values(&app, handle, count);
+}
+
+void ca_print_version(void) {
+    ca_ctx_print_version(&app);
+}
+
+void ca_print_help(void) {
+    ca_ctx_print_help(&app);
+}
+
+void ca_print_man(void) {
+    ca_ctx_print_man(&app);
+}
+
+void ca_print_completion(enum ca_shell shell) {
+    ca_ctx_print_completion(&app, shell);
+}
+
+size_t ca_render_help(char* buffer, size_t capacity) {
+    return ca_ctx_render_help(&app, buffer, capacity);
+}
+
+size_t ca_render_version(char* buffer, size_t capacity) {
+    return ca_ctx_render_version(&app, buffer, capacity);
+}
+
+const struct ca_stats* ca_get_stats(void) {
+    return ca_ctx_get_stats(&app);
 }
@@ -8,6 +8,8 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef CA_PUBLIC_SRC
 "Error: this header should be the only place where CA_PUBLIC_SRC is defined.";
@@ -93,13 +95,103 @@ void ca_synopsis(const char* synopsis);
  * treated verbatim. This is enabled by default. */
 void ca_use_end_of_options(bool use);
 
+/**
+ * Whether an argument `@path` should be replaced by the arguments in the file
+ * at `path`. This is disabled by default.
+ *
+ * Arguments in a response file are separated by whitespace, which can be
+ * included in an argument by quoting it with `'` or `"` or escaping it with
+ * `\`. Response files are read only from the command line itself, so `@path`
+ * within one is taken literally, as is `@path` after `--`. Arguments point
+ * into the file, which stays loaded until the next parse.
+ */
+void ca_use_response_files(bool use);
+
+/**
+ * Fills in options not passed on the command line from environment variables
+ * named `prefix` followed by their long names, uppercased and with `-` as
+ * `_`, so that `--dry-run` with the prefix `"MYTOOL_"` is set by
+ * `MYTOOL_DRY_RUN`. Passing `NULL` turns this off, as it is by default.
+ *
+ * The variable's value is the option's argument; an option that takes none is
+ * passed unless the value is empty or `0`, which leaves it to
+ * ca_config_file(). Names only map from options to variables, so a variable
+ * with a lowercase letter or `-` after the prefix never matches, and
+ * `--dryRun` is set by `MYTOOL_DRYRUN`. If several options map to one
+ * variable, the one spelled in lowercase wins, and otherwise the first
+ * registered. Variables that name no option, or `--help` or `--version`, are
+ * ignored. Filled options are checked for conflicts and reach their callbacks
+ * and handlers like any other, after those on the command line. Options are
+ * not filled in while iterating with ca_next().
+ *
+ * The environment is scanned on the first parse, and what it names is reused
+ * by every later parse with the same state, such as each reparse or each item
+ * a worker of ca_parse_batch() parses, until the options or this prefix
+ * change. Variables set afterward are not seen.
+ */
+void ca_env_prefix(const char* prefix);
+
+/**
+ * Fills in options passed neither on the command line nor through
+ * ca_env_prefix() from the config file at `path`, like ca_env_prefix().
+ * Passing `NULL` turns this off, as it is by default.
+ *
+ * Each line of the file is either blank, a comment starting with `#`, or a
+ * long option name, optionally followed by `=` and its argument, with
+ * surrounding whitespace ignored. A name given on several lines is passed as
+ * many times. A missing file is treated as an empty one, and names that match
+ * no option are ignored. Like the environment, the file is read once and
+ * reused by later parses, and arguments point into it, so it stays loaded
+ * until the state is released or this path changes.
+ */
+void ca_config_file(const char* path);
+
+/**
+ * Specifies whether the hidden option `--ca-man` is recognized, which prints
+ * the output of ca_print_man() and ends parsing like `--help`. It is not
+ * listed in `--help`, and an option registered as `ca-man` takes precedence.
+ * This is disabled by default.
+ */
+void ca_use_man_option(bool use);
+
+/**
+ * Specifies whether the hidden option `--ca-complete` is recognized, which the
+ * scripts from ca_print_completion() pass to ask the program how to complete
+ * a command line. It is not listed in `--help`, and an option registered as
+ * `ca-complete` takes precedence. This is disabled by default.
+ *
+ * It is followed by an index and the words of the command line being edited,
+ * starting with the program name, and it prints the words that can replace
+ * the one at that index, one per line: the options the word begins, or the
+ * subcommands if it is the first ordinary argument. An argument to an option
+ * gets none, which leaves it to the shell to complete file names. The rest of
+ * the command line is neither parsed nor checked, and no callbacks are
+ * invoked. After ca_parse() or ca_ctx_parse() answers, the program exits with
+ * status zero, since the shell only reads the output. Every other parse
+ * returns zero instead, and ca_ctx_answered_completion() or
+ * ca_state_answered_completion() tells the caller not to go on.
+ */
+void ca_use_complete_option(bool use);
+
 /** Specifies whether `--help` and `--version` should be overriden from their
  * defaults. */
 void ca_override_help_version(bool override_help, bool override_version);
 
+/**
+ * Uses the `length` bytes of `text` verbatim as the output of `--help` and
+ * ca_print_help(), instead of laying it out on every request. The text is not
+ * copied, but written from where it is each time, so it must stay valid while
+ * it is in use. Passing `NULL` goes back to the default.
+ */
+void ca_set_help_text(const char* text, size_t length);
+
+/** Behaves like ca_set_help_text() for `--version` and ca_print_version(). */
+void ca_set_version_text(const char* text, size_t length);
+
 /**
  * Registers a command-line option `short_opt`/`long_opt`. Sets `errno` on
- * failure.
+ * failure, to `EEXIST` if either name is already registered, or to `EINVAL`
+ * if the option is malformed or excludes itself, as in `"!@x"` on `-x`.
  *
  * The `behavior` parameter is easily the most confusing. I have written a
  * \ref book/opt.md "comprehensive breakdown" of the parameter.
@@ -113,9 +205,10 @@ void ca_override_help_version(bool override_help, bool override_version);
  * this option.
  * @param description A description of the option.
  *
- * @returns A handle to whether the flag was passed, or `NULL` on failure.
+ * @returns A handle to the option for ca_was_passed() and ca_arg(), or `-1`
+ * on failure. Handles stay valid as more options are registered.
  */
-bool* ca_opt(char short_opt, const char* long_opt, const char* behavior,
+int ca_opt(char short_opt, const char* long_opt, const char* behavior,
     const char** result, const char* description);
 
 /**
@@ -124,9 +217,103 @@ bool* ca_opt(char short_opt, const char* long_opt, const char* behavior,
  * Behaves equivalently to ca_opt() but with the short option variant neglected.
  * Please see there for further information.
  */
-bool* ca_long_opt(const char* long_opt, const char* behavior,
+int ca_long_opt(const char* long_opt, const char* behavior,
     const char** result, const char* description);
 
+/**
+ * Registers an option like ca_opt() whose argument is an `int`, which is
+ * converted while parsing and written to `*result`. Sets `errno` on failure.
+ *
+ * The behavior must specify an argument. An argument that is not a decimal
+ * integer, or that is out of range, is an error in the parse. `*result` is
+ * left alone unless the option is passed with an argument.
+ */
+int ca_opt_int(char short_opt, const char* long_opt, const char* behavior,
+    int* result, const char* description);
+
+/** Behaves like ca_opt_int() with an unsigned 64-bit argument. */
+int ca_opt_u64(char short_opt, const char* long_opt, const char* behavior,
+    uint64_t* result, const char* description);
+
+/**
+ * Behaves like ca_opt_int() with a `double` argument, written in decimal with
+ * an optional exponent. The decimal point is always `.`, whatever the locale.
+ */
+int ca_opt_double(char short_opt, const char* long_opt, const char* behavior,
+    double* result, const char* description);
+
+/**
+ * Behaves like ca_opt_int() with a `size_t` argument, which may end in `K`,
+ * `M`, `G`, or `T` to scale it by that power of 1024.
+ */
+int ca_opt_size(char short_opt, const char* long_opt, const char* behavior,
+    size_t* result, const char* description);
+
+/** An option of a table given to ca_opts(), as for ca_opt(). */
+struct ca_opt_spec {
+    char short_opt;
+    const char* long_opt;
+    const char* behavior;
+    const char** result;
+    const char* description;
+};
+
+/**
+ * Expands an entry of an X-macro option list to a `struct ca_opt_spec`
+ * initializer. `name` is unused here; see CA_OPT_HANDLE().
+ */
+#define CA_OPT_SPEC(name, short_opt, long_opt, behavior, result, description) \
+    {short_opt, long_opt, behavior, result, description},
+
+/**
+ * Expands an entry of an X-macro option list to an enumerator `name`, which
+ * is the offset of its handle from the one ca_opts() returns for the list.
+ */
+#define CA_OPT_HANDLE(name, short_opt, long_opt, behavior, result,            \
+    description)                                                               \
+    name,
+
+/**
+ * Registers the `count` options of `specs` at once, as if by ca_opt() in
+ * order, sizing the option table once for all of them. Sets `errno` on
+ * failure, in which case none of them are registered.
+ *
+ * The table is usually written once as an X-macro list and expanded both
+ * into the table and into names for the handles:
+ *
+ * ```c
+ * #define OPTIONS(X)                                          \
+ *     X(OPT_JOBS, 'j', "jobs", ".N", &jobs, "number of jobs") \
+ *     X(OPT_VERBOSE, 'v', "verbose", "*", NULL, "verbose")
+ *
+ * static const struct ca_opt_spec specs[] = {OPTIONS(CA_OPT_SPEC)};
+ * enum { OPTIONS(CA_OPT_HANDLE) };
+ *
+ * int first = ca_opts(specs, sizeof(specs) / sizeof(*specs));
+ * if (ca_was_passed(first + OPT_VERBOSE)) { ... }
+ * ```
+ *
+ * @returns The handle of the first option, or `-1` on failure. The rest
+ * follow it in order.
+ */
+int ca_opts(const struct ca_opt_spec* specs, size_t count);
+
+/**
+ * Freezes the option schema, building the lookup tables used by the parser.
+ *
+ * Calling this function is optional: ca_parse() freezes the schema itself if
+ * it is not already frozen. Freezing fails if an option refers to a short
+ * option that was never registered, which can only be decided once every
+ * option is, since options may refer to those registered after them.
+ * Registering another option afterward thaws the schema until the next
+ * freeze. Sets `errno` on failure.
+ *
+ * @pre ca_init() must have been called.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_freeze(void);
+
 /**
  * Sets two on-line callbacks that will be invoked during parsing. The provided
  * callbacks replace previously set ones. If either callback provided is `NULL`
@@ -139,6 +326,60 @@ void ca_set_callbacks(void (*opt_callback)(char, const char*, const char*,
                           void*),
     void (*arg_callback)(const char*, void*));
 
+/**
+ * Sets a handler for the option with `handle`, as returned by ca_opt(), that
+ * is invoked with its argument and `data` each time ca_parse() parses it,
+ * instead of the option callback given to ca_set_callbacks(). Passing `NULL`
+ * as the handler goes back to the option callback. Sets `errno` on failure.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_set_handler(int handle, void (*handler)(const char* arg, void* data),
+    void* data);
+
+struct ca_app;
+
+/**
+ * Registers a subcommand `name`, whose options are registered by
+ * `register_fn` only if it is selected. Sets `errno` on failure, to `ENOTSUP`
+ * in the fixed build, which would have to allocate the context of a selected
+ * subcommand.
+ *
+ * The first ordinary argument on the command line that names a subcommand
+ * selects it. The options before it are parsed and checked as usual, and then
+ * the subcommand gets a context of its own, which is passed to `register_fn`
+ * with `data`. That context parses the rest of the command line, starting
+ * with `name` in place of the program name, so it has its own options, help
+ * text, and conflicts. It takes the program name, version, authors, and
+ * parsing settings of its parent, and any of these can be changed in
+ * `register_fn`. Subcommands are not recognized in response files or in lines
+ * given to ca_parse_line().
+ *
+ * @param name The name of the subcommand.
+ * @param description A description of the subcommand for `--help`.
+ * @param register_fn Registers the options of the subcommand with the
+ * `ctx_` functions on the context it is passed.
+ * @param data Passed to `register_fn`.
+ *
+ * @returns A handle to the subcommand for ca_selected_subcommand(), or `-1`
+ * on failure.
+ */
+int ca_subcommand(const char* name, const char* description,
+    void (*register_fn)(struct ca_app* ctx, void* data), void* data);
+
+/**
+ * The handle of the subcommand selected in the most recent ca_parse(), or
+ * `-1` if there was none.
+ */
+int ca_selected_subcommand(void);
+
+/**
+ * The context of the subcommand selected in the most recent ca_parse(), or
+ * `NULL` if there was none. Its results are read with ca_ctx_was_passed() and
+ * friends, and it lasts until the next parse.
+ */
+struct ca_app* ca_subcommand_context(void);
+
 /**
  * Runs the parser on the command line arguments.
  *
@@ -147,19 +388,151 @@ void ca_set_callbacks(void (*opt_callback)(char, const char*, const char*,
  * callbacks will be invoked with `user_data` as its parameter (see
  * ca_set_callbacks()).
  *
+ * Unless overridden, `--help` and `--version` end parsing as soon as they are
+ * passed: their output is printed, the rest of the command line is neither
+ * parsed nor checked, and no callbacks are invoked.
+ *
  * @pre ca_init() must have been called.
  *
  * @returns Zero on success, nonzero on failure.
  *
  * \par Time Complexity
- * This function runs in `O(nm)` time where `n` is the number of parsed
- * options and arguments and `m` is the number of options, assuming that each
- * long option is roughly constant time in comparison. In other words, if
- * options `a`, `b`, and `c` all support multiflag, then `-abc` would correspond
- * with `n=3`.
+ * This function runs in `O(n)` time where `n` is the number of parsed
+ * options and arguments, besides building the lookup tables once after
+ * options are registered. Option lookups are expected constant time, option
+ * conflicts are checked once per distinct option passed, and only the
+ * options passed last time are reset. In other words, if options `a`, `b`,
+ * and `c` all support multiflag, then `-abc` would correspond with `n=3`.
  */
 int ca_parse(void* user_data);
 
+/**
+ * Runs the parser on `argc` and `argv` instead of the arguments given to
+ * ca_init(), which they replace for later parses. Callbacks are invoked as in
+ * ca_parse().
+ *
+ * Nothing is registered or allocated again, so a program with a large set of
+ * options can parse command after command at the cost of each command alone.
+ *
+ * @pre ca_init() must have been called.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_reparse(int argc, const char* argv[], void* user_data);
+
+/**
+ * Runs the parser on `line`, which is `length` bytes long, as if its
+ * arguments followed the program name on the command line, instead of on the
+ * arguments given to ca_init().
+ *
+ * The line is split like a shell would: arguments are separated by whitespace,
+ * which can be included in an argument by quoting it with `'` or `"` or
+ * escaping it with `\`. Arguments point into a copy of the line, which lasts
+ * until the next parse. Response files are not read from the line.
+ *
+ * @pre ca_init() must have been called.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_parse_line(const char* line, size_t length, void* user_data);
+
+struct ca_diagnostic;
+
+/**
+ * Records the errors found by later parses into `buffer`, which holds
+ * `capacity` records, instead of printing them, and keeps parsing past each
+ * error where it can. A parse with errors still fails without running
+ * callbacks, but it reports every unknown option, bad argument, and conflict
+ * instead of only the first. Running out of memory always ends the parse.
+ * Passing `NULL` goes back to printing the first error, as by default.
+ *
+ * @pre ca_init() must have been called.
+ */
+void ca_collect_diagnostics(struct ca_diagnostic* buffer, size_t capacity);
+
+/**
+ * The number of errors found by the most recent parse while collecting
+ * diagnostics. This may be more than the buffer given to
+ * ca_collect_diagnostics() holds, in which case the first that fit are in it.
+ */
+size_t ca_diagnostic_count(void);
+
+/**
+ * Whether the option with `handle`, as returned by ca_opt(), was passed in the
+ * most recent successful ca_parse().
+ */
+bool ca_was_passed(int handle);
+
+/**
+ * The latest argument passed to the option with `handle` in the most recent
+ * successful ca_parse(), or `NULL` if there was none.
+ */
+const char* ca_arg(int handle);
+
+/**
+ * Every argument passed to the option with `handle` in the most recent
+ * successful ca_parse(), in order, if its behavior has a `+`. Sets `*count` to
+ * how many there are.
+ *
+ * The array belongs to the library and lasts until the next parse. Options
+ * parsed one at a time with ca_next() keep no arguments here.
+ *
+ * @returns The arguments, or `NULL` if there were none.
+ */
+const char* const* ca_values(int handle, size_t* count);
+
+/** An option or argument yielded by ca_next(). */
+struct ca_item {
+    int handle;  ///< The option, as returned by ca_opt(), or `-1` for an
+                 ///< ordinary argument.
+    char short_opt;        ///< The short option, or `'\0'` if there is none.
+    const char* long_opt;  ///< The long option, or `NULL` for an ordinary
+                           ///< argument.
+    const char* arg;       ///< The argument, or `NULL` if there is none.
+    size_t arg_length;     ///< The length of `arg`, or zero if there is none.
+};
+
+/**
+ * Begins parsing the command line arguments one item at a time with
+ * ca_next(), instead of all at once with ca_parse().
+ *
+ * @pre ca_init() must have been called.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_iter_begin(void);
+
+/**
+ * Parses the next option or argument into `*item`. Items are yielded in
+ * command line order, and no more memory is used however many there are.
+ *
+ * Unlike ca_parse(), no callbacks are invoked and nothing is printed.
+ * Arguments to options are written through their `result` pointers as they
+ * are yielded. As with ca_parse(), `--help` and `--version` end the parse:
+ * they are yielded like any other option, but as the last item, and the
+ * program is left to act on them.
+ *
+ * @pre ca_iter_begin() must have been called.
+ *
+ * @returns `true` if an item was parsed, or `false` at the end of the command
+ * line or on an error, which ca_iter_finish() reports.
+ */
+bool ca_next(struct ca_item* item);
+
+/**
+ * Ends parsing with ca_next(). Any items not yet parsed are parsed and
+ * discarded, and then the option conflicts are checked, as they depend on the
+ * entire command line. Afterward, ca_was_passed() and ca_arg() report on the
+ * whole parse.
+ *
+ * If `--help` or `--version` ended the parse, nothing after it is parsed and
+ * no conflicts are checked, so ca_was_passed() and ca_arg() report only on
+ * the options before it, and zero is returned.
+ *
+ * @returns Zero if the command line is valid, nonzero otherwise.
+ */
+int ca_iter_finish(void);
+
 /**
  * Prints versioning information to standard output.
  *
@@ -174,6 +547,491 @@ void ca_print_version(void);
  */
 void ca_print_help(void);
 
+/**
+ * Lays out the output of ca_print_help() into `buffer`, which holds
+ * `capacity` bytes, truncating it if needed. The text is null-terminated
+ * unless `capacity` is zero. It is laid out once and reused until the program
+ * information or options change.
+ *
+ * @returns The length of the whole text, as with `snprintf`.
+ */
+size_t ca_render_help(char* buffer, size_t capacity);
+
+/** Behaves like ca_render_help() for ca_print_version(). */
+size_t ca_render_version(char* buffer, size_t capacity);
+
+/**
+ * Prints a manual page in roff to standard output, made from the same
+ * program information and options as ca_print_help() and ca_print_version().
+ * This stands in for running `help2man` on the program.
+ */
+void ca_print_man(void);
+
+/** A shell that ca_print_completion() writes a script for. */
+enum ca_shell {
+    CA_SHELL_BASH,  ///< Loaded with `source`.
+    CA_SHELL_ZSH,   ///< Loaded with `source` after `compinit`, or saved on
+                    ///< `fpath` as `_` followed by the program name.
+    CA_SHELL_FISH   ///< Loaded with `source`, or from `~/.config/fish`.
+};
+
+/**
+ * Prints a script to standard output that makes `shell` complete the command
+ * line of the program. The script only asks the program what to complete
+ * through `--ca-complete`, which must be enabled with
+ * ca_use_complete_option(), so it does not change as options are added.
+ */
+void ca_print_completion(enum ca_shell shell);
+
+/**
+ * \defgroup ctx Contexts
+ *
+ * Every function above operates on a single global context, so only one
+ * command line can be handled at a time. The functions here take the context
+ * explicitly instead, and each behaves exactly like its global counterpart.
+ * Distinct contexts share no state, so separate threads may each use their
+ * own without synchronization.
+ *
+ * @{
+ */
+
+/** A parsing context; see \ref ctx. */
+struct ca_app;
+
+/**
+ * Creates a context from the `argc` and `argv` parameters from the `main`
+ * function. Sets `errno` on failure.
+ *
+ * Unlike ca_init(), nothing is registered to run at program termination; the
+ * context must be released with ca_ctx_free().
+ *
+ * @returns The new context, or `NULL` on failure.
+ */
+struct ca_app* ca_ctx_new(int argc, const char* argv[]);
+
+/**
+ * Releases `ctx` and all resources allocated for it. If `NULL` is passed, this
+ * function has no effect.
+ */
+void ca_ctx_free(struct ca_app* ctx);
+
+/** See ca_description(). */
+void ca_ctx_description(struct ca_app* ctx, const char* description);
+
+/** See ca_author(). */
+void ca_ctx_author(struct ca_app* ctx, const char* author);
+
+/** See ca_year(). */
+void ca_ctx_year(struct ca_app* ctx, int year);
+
+/** See ca_version(). */
+void ca_ctx_version(struct ca_app* ctx, int major, int minor, int patch);
+
+/** See ca_versioning_info(). */
+void ca_ctx_versioning_info(struct ca_app* ctx, const char* info);
+
+/** See ca_synopsis(). */
+void ca_ctx_synopsis(struct ca_app* ctx, const char* synopsis);
+
+/** See ca_use_end_of_options(). */
+void ca_ctx_use_end_of_options(struct ca_app* ctx, bool use);
+
+/** See ca_use_response_files(). */
+void ca_ctx_use_response_files(struct ca_app* ctx, bool use);
+
+/** See ca_env_prefix(). */
+void ca_ctx_env_prefix(struct ca_app* ctx, const char* prefix);
+
+/** See ca_config_file(). */
+void ca_ctx_config_file(struct ca_app* ctx, const char* path);
+
+/** See ca_use_man_option(). */
+void ca_ctx_use_man_option(struct ca_app* ctx, bool use);
+
+/** See ca_use_complete_option(). */
+void ca_ctx_use_complete_option(struct ca_app* ctx, bool use);
+
+/** See ca_override_help_version(). */
+void ca_ctx_override_help_version(struct ca_app* ctx, bool override_help,
+    bool override_version);
+
+/** See ca_set_help_text(). */
+void ca_ctx_set_help_text(struct ca_app* ctx, const char* text, size_t length);
+
+/** See ca_set_version_text(). */
+void ca_ctx_set_version_text(struct ca_app* ctx, const char* text,
+    size_t length);
+
+/** See ca_opt(). */
+int ca_ctx_opt(struct ca_app* ctx, char short_opt, const char* long_opt,
+    const char* behavior, const char** result, const char* description);
+
+/** See ca_long_opt(). */
+int ca_ctx_long_opt(struct ca_app* ctx, const char* long_opt,
+    const char* behavior, const char** result, const char* description);
+
+/** See ca_opt_int(). */
+int ca_ctx_opt_int(struct ca_app* ctx, char short_opt, const char* long_opt,
+    const char* behavior, int* result, const char* description);
+
+/** See ca_opt_u64(). */
+int ca_ctx_opt_u64(struct ca_app* ctx, char short_opt, const char* long_opt,
+    const char* behavior, uint64_t* result, const char* description);
+
+/** See ca_opt_double(). */
+int ca_ctx_opt_double(struct ca_app* ctx, char short_opt, const char* long_opt,
+    const char* behavior, double* result, const char* description);
+
+/** See ca_opt_size(). */
+int ca_ctx_opt_size(struct ca_app* ctx, char short_opt, const char* long_opt,
+    const char* behavior, size_t* result, const char* description);
+
+/** See ca_opts(). */
+int ca_ctx_opts(struct ca_app* ctx, const struct ca_opt_spec* specs,
+    size_t count);
+
+/** See ca_freeze(). */
+int ca_ctx_freeze(struct ca_app* ctx);
+
+/** See ca_set_callbacks(). */
+void ca_ctx_set_callbacks(struct ca_app* ctx,
+    void (*opt_callback)(char, const char*, const char*, void*),
+    void (*arg_callback)(const char*, void*));
+
+/** See ca_set_handler(). */
+int ca_ctx_set_handler(struct ca_app* ctx, int handle,
+    void (*handler)(const char* arg, void* data), void* data);
+
+/** See ca_subcommand(). */
+int ca_ctx_subcommand(struct ca_app* ctx, const char* name,
+    const char* description,
+    void (*register_fn)(struct ca_app* ctx, void* data), void* data);
+
+/** See ca_selected_subcommand(). */
+int ca_ctx_selected_subcommand(const struct ca_app* ctx);
+
+/** See ca_subcommand_context(). */
+struct ca_app* ca_ctx_subcommand_context(const struct ca_app* ctx);
+
+/** See ca_parse(). */
+int ca_ctx_parse(struct ca_app* ctx, void* user_data);
+
+/** See ca_reparse(). */
+int ca_ctx_reparse(struct ca_app* ctx, int argc, const char* argv[],
+    void* user_data);
+
+/** See ca_parse_line(). */
+int ca_ctx_parse_line(struct ca_app* ctx, const char* line, size_t length,
+    void* user_data);
+
+/** See ca_collect_diagnostics(). */
+void ca_ctx_collect_diagnostics(struct ca_app* ctx,
+    struct ca_diagnostic* buffer, size_t capacity);
+
+/** See ca_diagnostic_count(). */
+size_t ca_ctx_diagnostic_count(const struct ca_app* ctx);
+
+/** See ca_iter_begin(). */
+int ca_ctx_iter_begin(struct ca_app* ctx);
+
+/** See ca_next(). */
+bool ca_ctx_next(struct ca_app* ctx, struct ca_item* item);
+
+/** See ca_iter_finish(). */
+int ca_ctx_iter_finish(struct ca_app* ctx);
+
+/**
+ * Whether the most recent parse of `ctx` answered `--ca-complete`; see
+ * ca_use_complete_option().
+ */
+bool ca_ctx_answered_completion(const struct ca_app* ctx);
+
+/** See ca_was_passed(). */
+bool ca_ctx_was_passed(const struct ca_app* ctx, int handle);
+
+/** See ca_arg(). */
+const char* ca_ctx_arg(const struct ca_app* ctx, int handle);
+
+/** See ca_values(). */
+const char* const* ca_ctx_values(const struct ca_app* ctx, int handle,
+    size_t* count);
+
+/** See ca_print_version(). */
+void ca_ctx_print_version(struct ca_app* ctx);
+
+/** See ca_print_help(). */
+void ca_ctx_print_help(struct ca_app* ctx);
+
+/** See ca_print_man(). */
+void ca_ctx_print_man(struct ca_app* ctx);
+
+/** See ca_print_completion(). */
+void ca_ctx_print_completion(struct ca_app* ctx, enum ca_shell shell);
+
+/** See ca_render_help(). */
+size_t ca_ctx_render_help(struct ca_app* ctx, char* buffer, size_t capacity);
+
+/** See ca_render_version(). */
+size_t ca_ctx_render_version(struct ca_app* ctx, char* buffer,
+    size_t capacity);
+
+/** @} */
+
+/**
+ * \defgroup state Concurrent parsing
+ *
+ * A context can only parse one command line at a time. Once frozen, though,
+ * its schema is never written to again: every parse writes only to a
+ * separate `struct ca_parse_state`. Any number of threads may therefore parse
+ * against one schema at the same time, each with its own state and without
+ * synchronization.
+ *
+ * A state does not write arguments through the `result` pointers given to
+ * ca_opt(), and ca_was_passed() does not see its results. Query the state
+ * instead with ca_state_was_passed() and ca_state_arg().
+ *
+ * @{
+ */
+
+/** The compiled, read-only schema of a context; see \ref state. */
+struct ca_schema;
+
+/** The results of parsing one command line; see \ref state. */
+struct ca_parse_state;
+
+/**
+ * Freezes `ctx` and returns its schema. Sets `errno` on failure.
+ *
+ * The schema belongs to `ctx`. It must not be used after `ctx` is released,
+ * and no options may be registered with `ctx` while states created from the
+ * schema are in use.
+ *
+ * @returns The schema, or `NULL` on failure.
+ */
+const struct ca_schema* ca_ctx_schema(struct ca_app* ctx);
+
+/**
+ * Saves the frozen `schema` as a flat blob for ca_schema_load() into
+ * `buffer`, which holds `capacity` bytes. Nothing is written unless the whole
+ * blob fits. Sets `errno` on failure.
+ *
+ * The blob holds offsets rather than pointers, so it can be written to a file
+ * and mapped read-only into any process using the same build of the library.
+ * The `--help` and `--version` text is saved already laid out. Result
+ * pointers, handlers, callbacks, and subcommands are not saved.
+ *
+ * @returns The size of the blob, whether or not it fit, or zero on failure.
+ */
+size_t ca_schema_serialize(const struct ca_schema* schema, void* buffer,
+    size_t capacity);
+
+/**
+ * Loads a schema saved by ca_schema_serialize() from `blob`, which is `size`
+ * bytes long and aligned to 8 bytes. Sets `errno` to `EINVAL` if the blob is
+ * malformed or from another build, or to `ENOMEM`.
+ *
+ * The blob is used in place and never written to, so it must outlast the
+ * schema; only the part of the option table that holds pointers is rebuilt.
+ *
+ * @returns A frozen schema for ca_state_new() and ca_parse_batch(), or `NULL`
+ * on failure.
+ */
+const struct ca_schema* ca_schema_load(const void* blob, size_t size);
+
+/**
+ * Releases a schema returned by ca_schema_load(). If `NULL` is passed, this
+ * function has no effect.
+ */
+void ca_schema_free(const struct ca_schema* schema);
+
+/**
+ * Creates a parse state for `schema`. Sets `errno` on failure.
+ *
+ * @returns The new state, or `NULL` on failure.
+ */
+struct ca_parse_state* ca_state_new(const struct ca_schema* schema);
+
+/**
+ * Releases `state`. If `NULL` is passed, this function has no effect.
+ */
+void ca_state_free(struct ca_parse_state* state);
+
+/**
+ * Parses `argc` and `argv`, which are as given to `main`, into `state`,
+ * discarding the results of any previous parse. Callbacks are invoked as in
+ * ca_parse(). Sets `errno` on failure.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_state_parse(struct ca_parse_state* state, int argc, const char* argv[],
+    void* user_data);
+
+/** Behaves like ca_state_parse() on a line; see ca_parse_line(). */
+int ca_state_parse_line(struct ca_parse_state* state, const char* line,
+    size_t length, void* user_data);
+
+/** Reasons a parse can fail. */
+enum ca_error {
+    CA_ERROR_NONE,            ///< The parse succeeded.
+    CA_ERROR_INVALID,         ///< The input or schema was unusable.
+    CA_ERROR_NO_MEMORY,       ///< Memory could not be allocated.
+    CA_ERROR_UNKNOWN_OPT,     ///< An unregistered option was passed.
+    CA_ERROR_MISSING_ARG,     ///< An option's required argument was missing.
+    CA_ERROR_UNEXPECTED_ARG,  ///< An argument was attached to an option that
+                              ///< takes none.
+    CA_ERROR_NOT_MULTIFLAG,   ///< An option that does not occur in multiflag
+                              ///< was combined with others.
+    CA_ERROR_CONFLICT,        ///< The options passed violate a quantifier.
+    CA_ERROR_FILE,            ///< A response or config file could not be
+                              ///< read.
+    CA_ERROR_BAD_VALUE        ///< A typed option's argument did not convert.
+};
+
+/** Why the most recent parse into `state` failed, or `CA_ERROR_NONE`. */
+enum ca_error ca_state_error(const struct ca_parse_state* state);
+
+/** See ca_ctx_answered_completion(). */
+bool ca_state_answered_completion(const struct ca_parse_state* state);
+
+/** An error found by a parse; see ca_collect_diagnostics(). */
+struct ca_diagnostic {
+    enum ca_error code;  ///< What went wrong.
+    int opt;        ///< The handle of the option at fault, or -1 if none.
+    int arg_index;  ///< The index in `argv` of the argument at fault, or -1
+                    ///< if there is none or it did not come from `argv`.
+};
+
+/** Like ca_collect_diagnostics() for the parses of `state`. */
+void ca_state_collect_diagnostics(struct ca_parse_state* state,
+    struct ca_diagnostic* buffer, size_t capacity);
+
+/** Like ca_diagnostic_count() for the most recent parse into `state`. */
+size_t ca_state_diagnostic_count(const struct ca_parse_state* state);
+
+/**
+ * Like ca_was_passed() for the most recent parse into `state`. The `handle`
+ * is the one ca_ctx_opt() returned for the option, which also names it in a
+ * schema loaded with ca_schema_load().
+ */
+bool ca_state_was_passed(const struct ca_parse_state* state, int handle);
+
+/** Like ca_arg() for the most recent parse into `state`. */
+const char* ca_state_arg(const struct ca_parse_state* state, int handle);
+
+/** Like ca_values() for the most recent parse into `state`. */
+const char* const* ca_state_values(const struct ca_parse_state* state,
+    int handle, size_t* count);
+
+/** One command line to parse with ca_parse_batch(). */
+struct ca_batch_item {
+    int argc;            ///< As given to `main`.
+    const char** argv;   ///< As given to `main`.
+};
+
+/**
+ * Parses each of the `count` command lines in `items` against `schema`,
+ * spreading them across `nthreads` threads, including the calling one. If
+ * `nthreads` is zero, one thread per online processor is used.
+ *
+ * Nothing is printed and no callbacks are invoked. Instead, the outcome of
+ * parsing `items[i]` is stored in `results[i]`. Sets `errno` on failure.
+ *
+ * @pre `schema` is frozen; see ca_ctx_schema().
+ *
+ * @returns Zero if every item was parsed, nonzero on failure.
+ */
+int ca_parse_batch(const struct ca_schema* schema,
+    const struct ca_batch_item* items, size_t count, enum ca_error* results,
+    size_t nthreads);
+
+/** @} */
+
+/**
+ * \defgroup memory Memory
+ *
+ * By default, each context carves its arrays out of one block, the arena,
+ * so that a short-lived program allocates only once and releases everything
+ * at once. Arrays that outgrow the arena fall back to the allocator.
+ *
+ * @{
+ */
+
+/** The functions through which the library allocates memory. */
+struct ca_allocator {
+    void* (*alloc)(size_t size, void* user);  ///< Like `malloc`.
+    void* (*realloc)(void* ptr, size_t size,
+        void* user);                          ///< Like `realloc`.
+    void (*free)(void* ptr, void* user);      ///< Like `free`.
+    void* user;  ///< Passed to each of the functions above.
+};
+
+/**
+ * Sets the allocator used by contexts created afterward, including the
+ * global one created by ca_init(). If `NULL` is passed, or any of the
+ * functions of `allocator` is `NULL`, the standard library allocator is
+ * restored.
+ */
+void ca_set_allocator(const struct ca_allocator* allocator);
+
+/**
+ * Sets the size in bytes of the arena for contexts created afterward. The
+ * arena is taken from the allocator in one piece; if `size_hint` is zero,
+ * every array is allocated separately instead.
+ *
+ * The default hint fits the arrays of a context with a few options. In a build
+ * with fixed storage (`CA_STATIC_CAPACITY`), there is no arena and nothing is
+ * allocated for a context beyond the context itself.
+ */
+void ca_set_arena(size_t size_hint);
+
+/** @} */
+
+/**
+ * \defgroup stats Statistics
+ *
+ * A build with `CA_STATS` defined counts what each context and state does and
+ * times the phases of each parse. Without it, none of this is compiled in,
+ * and the functions below return `NULL`.
+ *
+ * The numbers accumulate from creation until the context or state is freed.
+ *
+ * @{
+ */
+
+/** What a context or state has done so far. Times are in nanoseconds. */
+struct ca_stats {
+    uint64_t register_ns;   ///< Registering options and freezing the schema.
+    uint64_t construct_ns;  ///< Reading the command line into results.
+    uint64_t verify_ns;     ///< Checking the results for conflicts.
+    uint64_t callback_ns;   ///< Publishing results and running callbacks.
+
+    uint64_t short_lookups;  ///< Short options looked up while parsing.
+    uint64_t long_lookups;   ///< Long options looked up while parsing.
+    uint64_t lookup_hits;    ///< Lookups that found an option.
+    uint64_t lookup_misses;  ///< Lookups that found none.
+
+    uint64_t reallocs;         ///< Times an array grew.
+    uint64_t bytes_allocated;  ///< Bytes taken from the arena or allocator.
+
+    uint64_t results;    ///< Options and arguments yielded while parsing.
+    uint64_t callbacks;  ///< Handlers and callbacks invoked.
+};
+
+/**
+ * Returns the statistics of the global context, or `NULL` if the library was
+ * built without `CA_STATS`.
+ */
+const struct ca_stats* ca_get_stats(void);
+
+/** Like ca_get_stats() for `ctx`, including the parses of ca_ctx_parse(). */
+const struct ca_stats* ca_ctx_get_stats(const struct ca_app* ctx);
+
+/** Like ca_get_stats() for a state made with ca_state_new(). */
+const struct ca_stats* ca_state_get_stats(
+    const struct ca_parse_state* state);
+
+/** @} */
+
 #ifdef CA_PRIVATE_SRC
 
     #if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
@@ -181,15 +1039,60 @@ void ca_print_help(void);
         #include <unistd.h>
     #endif
 
+    #include <stdio.h>
+    #include <stdarg.h>
+
     #define HELLO_STRING "hello\n"
     #define CA_NO_YEAR -1
     #define CA_DESCRIPTION_OFFSET 20
+    #define CA_SHORT_OPT_COUNT (26 + 26 + 10)
+    #define CA_NO_OPT -1
+    #define CA_ARENA_ALIGN 16
+    #define CA_ARENA_DEFAULT 4096
+    // the longest long option that can be set from the environment
+    #define CA_MAX_ENV_NAME 128
+
+    // building with CA_STATIC_CAPACITY puts every array of a context or state
+    // in fixed storage inside the struct itself, so nothing is allocated; the
+    // limits below may each be overridden at build time
+    #ifdef CA_STATIC_CAPACITY
+        #ifndef CA_MAX_OPTIONS
+            #define CA_MAX_OPTIONS 32
+        #endif
+        #ifndef CA_MAX_RESULTS
+            #define CA_MAX_RESULTS 64
+        #endif
+        #ifndef CA_MAX_AUTHORS
+            #define CA_MAX_AUTHORS 4
+        #endif
+        #ifndef CA_MAX_SYNOPSES
+            #define CA_MAX_SYNOPSES 4
+        #endif
+        #ifndef CA_MAX_RESPONSE_FILES
+            #define CA_MAX_RESPONSE_FILES 4
+        #endif
+        #ifndef CA_MAX_LINE
+            #define CA_MAX_LINE 1024
+        #endif
+        #ifndef CA_MAX_FALLBACKS
+            #define CA_MAX_FALLBACKS 32
+        #endif
+        #ifndef CA_MAX_TEXT
+            #define CA_MAX_TEXT 4096
+        #endif
+        // enough for the long option table at any number of options up to
+        // CA_MAX_OPTIONS; see ca_opt()
+        #define CA_MAX_LONG_OPTS (4 * CA_MAX_OPTIONS + 16)
+    #endif
 
 /** Option information. */
 enum ca_opt_flags {
     CA_OPT_ARG = 1 << 0,     ///< Takes an argument.
     CA_OPT_OPTARG = 1 << 1,  ///< Argument is optional.
-    CA_OPT_MFLAG = 1 << 2    ///< Occurs in multiflag.
+    CA_OPT_MFLAG = 1 << 2,   ///< Occurs in multiflag.
+    CA_OPT_MANY = 1 << 3,    ///< Keeps every argument, not just the latest.
+    CA_OPT_HELP = 1 << 4,    ///< Is `--help`.
+    CA_OPT_VERSION = 1 << 5  ///< Is `--version`.
 };
 
 /** Quantifiers for determining option compatibility. */
@@ -201,19 +1104,40 @@ enum ca_opt_quantifier {
     CA_OPT_QUANTIFIER_ONLY   ///< Only the provided options can be passed.
 };
 
-/** A command line option. */
+/**
+ * The parts of a command line option read on every lookup and check, kept
+ * apart from the rest so that several options share a cache line.
+ */
+struct ca_opt_hot {
+    uint64_t refs_mask;   ///< The short option index bits of the refs.
+    uint8_t flags;        ///< Option flags; see `enum ca_opt_flags`.
+    uint8_t quantifier;   ///< Conflict quantifier; see
+                          ///< `enum ca_opt_quantifier`.
+    bool quantifier_is_negated;  ///< Whether `quantifier` is negated.
+    char short_opt;  ///< Short version of the command, or `'\0'` if none.
+};
+
+/** What an option converts its argument to. */
+enum ca_value_type {
+    CA_VALUE_STRING,  ///< Kept as is, in a `const char*`.
+    CA_VALUE_INT,     ///< An `int`.
+    CA_VALUE_U64,     ///< A `uint64_t`.
+    CA_VALUE_DOUBLE,  ///< A `double`.
+    CA_VALUE_SIZE     ///< A `size_t`, with an optional binary suffix.
+};
+
+/** The rest of a command line option, read mostly for messages and help. */
 struct ca_opt {
-    char short_opt;        ///< Short version of the command, or `'\0'` if none.
-    const char* long_opt;  ///< Long version of the command.
-    enum ca_opt_flags flags;            ///< Option flags.
-    bool quantifier_is_negated;         ///< Whether `quantifier` is negated.
-    enum ca_opt_quantifier quantifier;  ///< Conflict quantifier.
+    const char* long_opt;     ///< Long version of the command.
     const char* refs;         ///< A null-terminated list of option refs.
-    const char** result;      ///< A pointer to where the passed arg should go.
+    void* result;             ///< A pointer to where the passed arg should go,
+                              ///< of the type given by `type`.
+    enum ca_value_type type;  ///< What the passed arg is converted to.
     const char* arg_name;     ///< Name of the argument.
     const char* description;  ///< Option description.
-    bool was_passed;  ///< Whether the option has been passed in the current
-                      ///< run of prasing.
+    void (*handler)(const char*, void*);  ///< Invoked instead of the option
+                                          ///< callback, or `NULL`.
+    void* handler_data;  ///< Passed to `handler`.
 };
 
 /**
@@ -221,20 +1145,160 @@ struct ca_opt {
  *
  * State | Meaning
  * --- | ---
- * `opt != NULL && arg != NULL` | Option with argument.
- * `opt == NULL && arg != NULL` | Option without argument.
- * `opt != NULL && arg == NULL` | Ordinary argument.
- * `opt == NULL && arg == NULL` | This state is disallowed.
+ * `opt != CA_NO_OPT && arg != NULL` | Option with argument.
+ * `opt != CA_NO_OPT && arg == NULL` | Option without argument.
+ * `opt == CA_NO_OPT && arg != NULL` | Ordinary argument.
+ * `opt == CA_NO_OPT && arg == NULL` | This state is disallowed.
  */
 struct ca_parse_result {
-    const struct ca_opt* opt;
-    const char* arg;
+    int opt;  ///< Index of the option, or `CA_NO_OPT`.
+    int arg_index;  ///< The index in `argv` of the argument or response file
+                    ///< it came from, or -1 if it came from neither.
+    const char* arg;    ///< Points into the command line, never into a copy.
+    size_t arg_length;  ///< The length of `arg`, or zero if there is none.
 };
 
-/** Library data for the command line app. */
-struct ca_app {
-    int argc;
-    const char** argv;
+/** What ended a parse before the end of its command line. */
+enum ca_exit {
+    CA_EXIT_NONE,     ///< The whole command line was parsed.
+    CA_EXIT_HELP,     ///< `--help` was passed.
+    CA_EXIT_VERSION,  ///< `--version` was passed.
+    CA_EXIT_MAN,      ///< The hidden `--ca-man` was passed.
+    CA_EXIT_COMPLETE  ///< The hidden `--ca-complete` was passed.
+};
+
+/** Text laid out once and kept until the schema changes. */
+struct ca_text_cache {
+    char* data;       ///< The text, null-terminated.
+    size_t length;    ///< The length of the text.
+    size_t capacity;  ///< The size of `data`.
+    bool valid;       ///< Whether `data` reflects the schema.
+    #ifdef CA_STATIC_CAPACITY
+    char data_storage[CA_MAX_TEXT];
+    #endif
+};
+
+/** The arguments an option kept, as a range of ca_parse_state::values. */
+struct ca_values_span {
+    size_t start;
+    size_t count;
+};
+
+/**
+ * Where a context or state allocates from.
+ *
+ * Allocations are bumped off the end of `arena` while it has room and taken
+ * from `allocator` afterward. Arena allocations are never freed one at a
+ * time; the whole arena goes at once in ca_memory_deinit().
+ */
+struct ca_memory {
+    struct ca_allocator allocator;
+    #ifdef CA_STATS
+    struct ca_stats stats;  ///< Kept for whatever allocates from here.
+    #endif
+    char* arena;            ///< The arena, or `NULL` if there is none.
+    size_t arena_capacity;  ///< The size of `arena` in bytes.
+    size_t arena_length;    ///< The bytes of `arena` in use.
+    void* arena_last;       ///< The most recent arena allocation, which can
+                            ///< grow in place.
+};
+
+/** A subcommand, registered lazily; see ca_subcommand(). */
+struct ca_subcommand {
+    const char* name;
+    const char* description;
+    void (*register_fn)(struct ca_app*, void*);
+    void* data;  ///< Passed to `register_fn`.
+};
+
+    #define CA_BLOB_MAGIC "cmdapp\x01"
+    #define CA_BLOB_VERSION 3
+
+/**
+ * An option as saved in a schema blob. Strings are offsets into the blob, or
+ * zero for `NULL`.
+ */
+struct ca_blob_opt {
+    uint64_t long_opt;
+    uint64_t arg_name;  ///< Terminated where the argument name ends.
+    uint64_t description;
+    uint32_t type;  ///< See `enum ca_value_type`.
+    uint32_t reserved;
+};
+
+/**
+ * The start of a schema blob, which locates everything else by its offset
+ * from here; see ca_schema_serialize(). Arrays are aligned to 8 bytes.
+ */
+struct ca_blob_header {
+    char magic[8];         ///< `CA_BLOB_MAGIC`.
+    uint32_t version;      ///< `CA_BLOB_VERSION`.
+    uint32_t header_size;  ///< The size of this struct when saved.
+    uint32_t hot_size;     ///< The size of `struct ca_opt_hot` when saved.
+    uint32_t reserved;
+    uint64_t size;         ///< The size of the whole blob.
+
+    uint64_t program;
+    uint64_t description;
+    uint64_t ver_info;
+    uint64_t env_prefix;
+    uint64_t config_path;
+    uint64_t authors;  ///< An array of string offsets.
+    uint64_t authors_length;
+    uint64_t synopses;  ///< An array of string offsets.
+    uint64_t synopses_length;
+    uint64_t help_text;  ///< Not terminated.
+    uint64_t help_length;
+    uint64_t version_text;  ///< Not terminated.
+    uint64_t version_length;
+
+    uint64_t options;  ///< An array of `struct ca_blob_opt`.
+    uint64_t hot;      ///< An array of `struct ca_opt_hot`.
+    uint64_t options_length;
+    uint64_t long_opts;  ///< An array of `int`, as in the schema.
+    uint64_t long_opts_capacity;
+    uint64_t short_opts_mask;
+    uint64_t mflag_mask;
+    int32_t short_opts[CA_SHORT_OPT_COUNT];
+
+    int32_t year;
+    int32_t ver_major;
+    int32_t ver_minor;
+    int32_t ver_patch;
+    uint8_t use_end_of_options;
+    uint8_t use_response_files;
+    uint8_t use_man_option;
+    uint8_t use_complete_option;
+    uint8_t override_help;
+    uint8_t override_version;
+};
+
+/** A response file loaded for a parse; see ca_use_response_files(). */
+struct ca_response {
+    char* data;     ///< The contents, followed by a spare zero byte.
+    size_t size;    ///< The size of the file in bytes.
+    size_t length;  ///< The size of `data` as loaded, in bytes.
+};
+
+/**
+ * An option named by the environment or config file; see
+ * ca_state_fill_fallbacks().
+ */
+struct ca_fallback {
+    int opt;          ///< The option it names.
+    const char* arg;  ///< Its value, or `NULL` if it has none.
+};
+
+/**
+ * The compiled description of a command line app: everything that does not
+ * change from one parse to the next.
+ *
+ * Once frozen, a schema is only ever read by the parser, so any number of
+ * `struct ca_parse_state` may parse against it at once.
+ */
+struct ca_schema {
+    struct ca_memory memory;  ///< Holds the arrays of the schema and of the
+                              ///< state of its context.
 
     const char* program;      ///< The name of the program as invoked.
 
@@ -258,15 +1322,40 @@ struct ca_app {
     const char* ver_info;     ///< Additional versioning information or `NULL`.
 
     bool use_end_of_options;  ///< see ca_use_end_of_options().
+    bool use_response_files;  ///< see ca_use_response_files().
+    bool use_man_option;      ///< see ca_use_man_option().
+    bool use_complete_option;  ///< see ca_use_complete_option().
+    const char* env_prefix;   ///< See ca_env_prefix(), or `NULL`.
+    const char* config_path;  ///< See ca_config_file(), or `NULL`.
 
     size_t options_length;
     size_t options_capacity;
     struct ca_opt* options;  ///< Program options.
+    size_t hot_capacity;
+    struct ca_opt_hot* hot;  ///< The hot parts of `options`, of which there
+                             ///< are as many.
 
-    size_t results_length;
-    size_t results_capacity;
-    size_t options_count;             ///< The number of options parsed.
-    struct ca_parse_result* results;  ///< Results of most recent parse.
+    int short_opts[CA_SHORT_OPT_COUNT];  ///< Index into `options` for each
+                                         ///< short option, or `CA_NO_OPT`.
+
+    size_t long_opts_capacity;  ///< A power of two, or zero if not built.
+    int* long_opts;  ///< Open-addressed hash table of indices into `options`
+                     ///< keyed by long option, with `CA_NO_OPT` slots empty,
+                     ///< kept up to date as options are registered.
+    bool frozen;     ///< Whether the refs of every option have been checked
+                     ///< and the tables built; see ca_freeze().
+
+    size_t subcommands_length;
+    size_t subcommands_capacity;
+    struct ca_subcommand* subcommands;  ///< Registered subcommands.
+    size_t subcommand_slots_capacity;  ///< A power of two, or zero if not
+                                       ///< built.
+    int* subcommand_slots;  ///< Hash table of indices into `subcommands`
+                            ///< keyed by name, built like `long_opts`.
+
+    uint64_t short_opts_mask;  ///< The index bits of every short option.
+    uint64_t mflag_mask;  ///< The index bits of the short options that are
+                          ///< multiflags, by the option each one maps to.
 
     void (*opt_callback)(char, const char*, const char*,
         void*);                       ///< Option callback.
@@ -274,6 +1363,140 @@ struct ca_app {
 
     bool override_help;     ///< Whether the user overrode `-h`/`--help`.
     bool override_version;  ///< Whether  the user overrode `-v`/`--version`.
+
+    const char* help_text;     ///< See ca_set_help_text(), or `NULL`.
+    size_t help_length;
+    const char* version_text;  ///< See ca_set_version_text(), or `NULL`.
+    size_t version_length;
+
+    struct ca_text_cache help_cache;     ///< The laid out `--help` output.
+    struct ca_text_cache version_cache;  ///< The laid out `--version` output.
+
+#ifdef CA_STATIC_CAPACITY
+    // fixed storage for the arrays above
+    const char* authors_storage[CA_MAX_AUTHORS];
+    const char* synopses_storage[CA_MAX_SYNOPSES];
+    struct ca_opt options_storage[CA_MAX_OPTIONS];
+    struct ca_opt_hot hot_storage[CA_MAX_OPTIONS];
+    int long_opts_storage[CA_MAX_LONG_OPTS];
+#endif
+};
+
+/** Everything written while parsing one command line against a schema. */
+struct ca_parse_state {
+    const struct ca_schema* schema;  ///< The schema parsed against.
+
+    struct ca_memory* memory;     ///< Holds the arrays of the state.
+    struct ca_memory own_memory;  ///< Used as `memory` unless another is
+                                  ///< given to ca_state_init().
+
+    int argc;
+    const char** argv;
+
+    size_t results_length;
+    size_t results_capacity;
+    struct ca_parse_result* results;  ///< Results of most recent parse.
+
+    size_t passed_length;
+    size_t passed_capacity;
+    int* passed;  ///< Indices of the distinct options passed in the most
+                  ///< recent parse, in order of first occurrence.
+    uint64_t passed_mask;  ///< The short option index bits of `passed`.
+
+    bool quiet;           ///< Whether errors go unprinted.
+    enum ca_error error;  ///< Why the most recent parse failed, the first
+                          ///< time if it went on.
+    bool halted;          ///< Whether an error ended the parse, which every
+                          ///< one does unless diagnostics are collected.
+
+    struct ca_diagnostic* diagnostics;  ///< Where errors are recorded
+                                        ///< instead of printed, or `NULL`.
+    size_t diagnostics_capacity;
+    size_t diagnostics_length;  ///< The errors found in the most recent
+                                ///< parse, even those that did not fit.
+
+    size_t options_capacity;  ///< The length of the per-option arrays below.
+    bool* was_passed;   ///< Whether each option was passed.
+    const char** args;  ///< The latest argument to each option passed with
+                        ///< one, or `NULL`.
+    struct ca_values_span* spans;  ///< Where the arguments each option kept
+                                   ///< are in `values`.
+
+    size_t values_capacity;
+    const char** values;  ///< The arguments kept by every option with
+                          ///< `CA_OPT_MANY`, grouped by option.
+
+    int next_arg;         ///< The index in `argv` of the next argument.
+    const char* cluster;  ///< The rest of the multiflag argument being
+                          ///< parsed, or `NULL`.
+    bool only_args;       ///< Whether `--` ended the options.
+    int pending_opt;      ///< The option waiting for its argument, or
+                          ///< `CA_NO_OPT`.
+    int arg_index;        ///< The index in `argv` of the argument being
+                          ///< parsed, or -1 before any.
+    int pending_index;    ///< The `arg_index` of `pending_opt`.
+    const char* held_arg;  ///< An argument read ahead of its turn, or `NULL`.
+    enum ca_exit exit;  ///< What ended the parse early, if anything.
+    bool had_arg;       ///< Whether an ordinary argument was yielded.
+    int subcommand;     ///< The subcommand selected, which ended the parse,
+                        ///< or `CA_NO_OPT`.
+    int subcommand_arg;  ///< The index in `argv` of its name.
+    int complete_arg;    ///< The index in `argv` of the argument after
+                         ///< `--ca-complete`, if it ended the parse.
+
+    size_t responses_length;
+    size_t responses_capacity;
+    struct ca_response* responses;  ///< Response files read this parse.
+    char* tokens;      ///< Where to split the next token off the latest
+                       ///< response file or line, or `NULL` if not reading
+                       ///< one.
+    char* tokens_end;  ///< The end of the latest response file or line.
+
+    size_t line_capacity;
+    char* line;  ///< A copy of the line given to ca_state_parse_line().
+    const char* line_argv[2];  ///< The command line the line follows.
+
+    bool fallbacks_read;  ///< Whether the fields below were read for the
+                          ///< schema as it is now.
+    size_t fallbacks_options;      ///< The options of the schema when read.
+    const char* fallbacks_prefix;  ///< Its environment prefix when read.
+    const char* fallbacks_path;    ///< Its config path when read.
+    size_t fallbacks_length;
+    size_t fallbacks_capacity;
+    struct ca_fallback* fallbacks;  ///< What the environment names, followed
+                                    ///< by what the config file does.
+    size_t env_fallbacks;  ///< How many of `fallbacks` are from the
+                           ///< environment.
+    bool has_config;  ///< Whether `config` holds the config file, which
+                      ///< `fallbacks` point into.
+    struct ca_response config;
+    int config_error;  ///< Why the config file could not be read, or zero.
+
+#ifdef CA_STATIC_CAPACITY
+    // fixed storage for the arrays above, with a spare per-option entry as in
+    // ca_state_new()
+    struct ca_parse_result results_storage[CA_MAX_RESULTS];
+    int passed_storage[CA_MAX_OPTIONS];
+    bool was_passed_storage[CA_MAX_OPTIONS + 1];
+    const char* args_storage[CA_MAX_OPTIONS + 1];
+    struct ca_values_span spans_storage[CA_MAX_OPTIONS + 1];
+    const char* values_storage[CA_MAX_RESULTS];
+    struct ca_response responses_storage[CA_MAX_RESPONSE_FILES];
+    char line_storage[CA_MAX_LINE];
+    struct ca_fallback fallbacks_storage[CA_MAX_FALLBACKS];
+#endif
+};
+
+/** Library data for the command line app. */
+struct ca_app {
+    struct ca_schema schema;
+    struct ca_parse_state state;  ///< Used by ca_ctx_parse().
+
+    int argc;            ///< As given to ca_ctx_new().
+    const char** argv;   ///< As given to ca_ctx_new().
+
+    struct ca_app* sub;  ///< The context of the subcommand selected in the
+                         ///< latest parse, or `NULL`.
 };
 
 /**
@@ -286,4 +1509,251 @@ void ca_deinit(void);
 /** Prints a command line parsing error to standard error. */
 void ca_print_error(const char* fmt, ...);
 
+/** Behaves like ca_print_error() with a `va_list`. */
+void ca_vprint_error(const char* fmt, va_list args);
+
+/**
+ * Records that the parse into `state` failed with `error` at the option `opt`
+ * and the argument at `arg_index` in `argv`, either of which may be absent as
+ * in `struct ca_diagnostic`. Unless diagnostics are being collected, this
+ * ends the parse and, unless `state` is quiet, prints the message formatted
+ * from `fmt`.
+ */
+void ca_report_error(struct ca_parse_state* state, enum ca_error error,
+    int opt, int arg_index, const char* fmt, ...);
+
+/**
+ * Initializes `memory` with the allocator from ca_set_allocator() and, if
+ * `use_arena`, an arena sized by ca_set_arena(). Returns zero on success,
+ * nonzero otherwise.
+ */
+int ca_memory_init(struct ca_memory* memory, bool use_arena);
+
+/** Releases the arena of `memory` and everything allocated from it. */
+void ca_memory_deinit(struct ca_memory* memory);
+
+/** Allocates `size` bytes from `memory`, or returns `NULL` on failure. */
+void* ca_memory_alloc(struct ca_memory* memory, size_t size);
+
+/**
+ * Resizes `ptr`, which holds `old_size` bytes allocated from `memory`, to
+ * `new_size` bytes. Returns the resized allocation, or `NULL` on failure, in
+ * which case `ptr` is left untouched.
+ */
+void* ca_memory_realloc(struct ca_memory* memory, void* ptr, size_t old_size,
+    size_t new_size);
+
+/** Frees `ptr`, allocated from `memory`, unless it lies in the arena. */
+void ca_memory_free(struct ca_memory* memory, void* ptr);
+
+/**
+ * Grows the array `*arrptr` of `elem_size`-byte elements from `memory` so that
+ * `*cap` exceeds `length`. Returns zero on success, nonzero otherwise.
+ */
+int ca_dynamic_reserve(struct ca_memory* memory, void* arrptr,
+    size_t elem_size, size_t length, size_t* cap);
+
+/**
+ * Initializes `state` to parse against `schema`, allocating from `memory`. If
+ * `memory` is `NULL`, `state` allocates from memory of its own without an
+ * arena. Returns zero on success, nonzero otherwise.
+ */
+int ca_state_init(struct ca_parse_state* state,
+    const struct ca_schema* schema, struct ca_memory* memory);
+
+/** Releases all resources allocated for `state`, but not `state` itself. */
+void ca_state_deinit(struct ca_parse_state* state);
+
+/**
+ * Readies `state` to parse `argv`, discarding the previous parse. Returns zero
+ * on success, nonzero otherwise.
+ *
+ * @pre The schema of `state` is frozen.
+ */
+int ca_state_reset(struct ca_parse_state* state, int argc,
+    const char* argv[]);
+
+/**
+ * Loads the response file at `path` for `state` to read tokens from. Sets
+ * `errno` on failure.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_response_open(struct ca_parse_state* state, const char* path);
+
+/**
+ * Splits the next token off the latest response file or line of `state`,
+ * unquoting and terminating it in place. Returns the token, or `NULL` if there
+ * are none left.
+ *
+ * @pre There is a writable byte at `state->tokens_end`.
+ */
+char* ca_split_token(struct ca_parse_state* state);
+
+/**
+ * Converts `arg`, which is `length` bytes long, to `type` and writes it to
+ * `*value`, which must be of that type. Sets `errno` to `EINVAL` if `arg` is
+ * malformed or `ERANGE` if it is out of range.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_parse_value(enum ca_value_type type, const char* arg, size_t length,
+    void* value);
+
+/**
+ * Where rendered text goes: into `data` while it has room, and then into
+ * `out` in pieces if it is non-`NULL`. Otherwise, the rest is only counted.
+ */
+struct ca_text {
+    char* data;
+    size_t capacity;  ///< The size of `data`.
+    size_t used;      ///< The bytes of `data` not yet flushed.
+    size_t length;    ///< The length of everything appended.
+    FILE* out;        ///< Where `data` is flushed when full, or `NULL`.
+};
+
+/** Begins appending to `data`, which holds `capacity` bytes, or to `out`. */
+void ca_text_init(struct ca_text* text, char* data, size_t capacity,
+    FILE* out);
+
+/** Appends the `length` bytes of `str` to `text`. */
+void ca_text_append(struct ca_text* text, const char* str, size_t length);
+
+/** Appends the null-terminated `str` to `text`. */
+void ca_text_puts(struct ca_text* text, const char* str);
+
+/** Writes what `text` holds to its stream, if it has one, and empties it. */
+void ca_text_flush(struct ca_text* text);
+
+/** Lays out the `--help` output of `schema` into `text`. */
+void ca_render_help_text(const struct ca_schema* schema, struct ca_text* text);
+
+/** Lays out the `--version` output of `schema` into `text`. */
+void ca_render_version_text(const struct ca_schema* schema,
+    struct ca_text* text);
+
+/** Lays out a manual page for `schema` into `text`; see ca_print_man(). */
+void ca_render_man_text(const struct ca_schema* schema, struct ca_text* text);
+
+/**
+ * Lays out a script for `shell` into `text` that completes the program of
+ * `schema`; see ca_print_completion().
+ */
+void ca_render_completion_text(const struct ca_schema* schema,
+    enum ca_shell shell, struct ca_text* text);
+
+/**
+ * Lays out the text `render` produces for `schema` into `cache` unless it is
+ * already up to date. Sets `errno` on failure.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_cache_text(struct ca_schema* schema, struct ca_text_cache* cache,
+    void (*render)(const struct ca_schema*, struct ca_text*));
+
+/**
+ * Prints the text `render` produces for `schema` to the standard output, in
+ * one write if `cache` is non-`NULL` and up to date.
+ */
+void ca_print_text(const struct ca_schema* schema,
+    const struct ca_text_cache* cache,
+    void (*render)(const struct ca_schema*, struct ca_text*));
+
+/**
+ * Copies the text `render` produces for `schema` into `buffer`, which holds
+ * `capacity` bytes, as in ca_render_help(), through `cache` unless it is
+ * `NULL`.
+ */
+size_t ca_copy_text(struct ca_schema* schema, struct ca_text_cache* cache,
+    void (*render)(const struct ca_schema*, struct ca_text*), char* buffer,
+    size_t capacity);
+
+/**
+ * Reads a monotonic clock in nanoseconds, for timing the phases counted in
+ * `struct ca_stats`.
+ */
+uint64_t ca_stats_now(void);
+
+/**
+ * Loads the contents of `path` into `*response` with one spare zero byte
+ * after them, so that the last token has room for its terminator. Sets
+ * `errno` on failure.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_response_load(struct ca_parse_state* state, const char* path,
+    struct ca_response* response);
+
+/** Releases what ca_response_load() loaded into `response`. */
+void ca_response_release(struct ca_parse_state* state,
+    struct ca_response* response);
+
+/**
+ * Loads the file at `path` for `state` like a response file, without reading
+ * tokens from it. Sets `*size` to its size, after which there is a spare zero
+ * byte. Sets `errno` on failure.
+ *
+ * @returns The writable contents, or `NULL` on failure.
+ */
+char* ca_response_map(struct ca_parse_state* state, const char* path,
+    size_t* size);
+
+/**
+ * Looks up the long option named by the first `length` bytes of `name` for
+ * `state`, counting the lookup; see ca_lookup_long_opt().
+ *
+ * @returns The index of the option, or `CA_NO_OPT` if there is none.
+ */
+int ca_state_lookup_long(struct ca_parse_state* state, const char* name,
+    size_t length);
+
+/**
+ * Passes the option at `opt` with `arg`, which may be `NULL`, unless it was
+ * passed before the `earlier` entries of `state->passed` were. `CA_NO_OPT` is
+ * ignored.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_state_fill(struct ca_parse_state* state, int opt, const char* arg,
+    size_t earlier);
+
+/**
+ * Fills in the options of `state` not passed on the command line from the
+ * environment and config file of its schema, if it has them. They are read
+ * the first time and reused until the schema changes.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+int ca_state_fill_fallbacks(struct ca_parse_state* state);
+
+/** Releases what ca_state_fill_fallbacks() read for `state`. */
+void ca_state_drop_fallbacks(struct ca_parse_state* state);
+
+/** Releases every response file loaded for `state`. */
+void ca_response_close_all(struct ca_parse_state* state);
+
+/**
+ * Parses the next option or argument of `state` into `*result`, recording it
+ * as passed. Returns a positive value if a result was parsed, zero at the end
+ * of the command line, or a negative value on failure, after which nothing
+ * more is parsed unless diagnostics are being collected.
+ *
+ * @pre `state` has been readied with ca_state_reset().
+ */
+int ca_state_next(struct ca_parse_state* state,
+    struct ca_parse_result* result);
+
+/**
+ * Iterates over the command line arguments of `state` and constructs a
+ * resulting array of options and arguments. Returns zero on success, nonzero
+ * otherwise.
+ */
+int ca_construct_results(struct ca_parse_state* state);
+
+/**
+ * Determines whether the parsed results in `state` have any conflicts. Returns
+ * zero if there are none, nonzero otherwise.
+ */
+int ca_verify_results(struct ca_parse_state* state);
+
 #endif
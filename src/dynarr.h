@@ -4,23 +4,55 @@
 
 #ifdef CA_PRIVATE_SRC
 
-    #define ca_dynamic_new(T, __len, __cap)                                    \
-        (__len = 0, __cap = 16, malloc(sizeof(T) * (__cap)))
-
-    /**
-     * @pre `__arrptr` has been allocated with ca_dynamic_new().
-     */
-    #define ca_dynamic_push(__arrptr, __len, __cap, __newelem)                 \
-        do {                                                                   \
-            if ((__len) + 1 >= (__cap)) {                                      \
-                __cap *= 2;                                                    \
-                *(__arrptr) = realloc(*__arrptr,                               \
-                    sizeof(*(__arrptr)) * (__cap));                            \
-                if (!*(__arrptr)) {                                            \
-                    exit(1);                                                   \
-                }                                                              \
-            }                                                                  \
-            (*(__arrptr))[(__len)++] = (__newelem);                            \
-        } while (0)
+    #ifdef CA_STATIC_CAPACITY
+
+        /**
+         * Points `__arr` at its fixed storage `__arr##_storage` and evaluates
+         * to it. Nothing is allocated, so `__mem` is unused.
+         */
+        #define ca_dynamic_new(__mem, __arr, __len, __cap)                     \
+            ((void)(__mem), __len = 0,                                         \
+                __cap = sizeof(__arr##_storage) / sizeof(*(__arr##_storage)),  \
+                (__arr) = (__arr##_storage))
+
+        /**
+         * Appends `__newelem` if the fixed storage has room. Evaluates to zero
+         * on success and nonzero if it is full, in which case `errno` is set.
+         */
+        #define ca_dynamic_push(__mem, __arrptr, __len, __cap, __newelem)      \
+            ((void)(__mem), (__len) + 1 > (__cap)                              \
+                                ? (errno = ENOMEM, 1)                          \
+                                : ((*(__arrptr))[(__len)++] = (__newelem), 0))
+
+        /** Fixed storage is never released. */
+        #define ca_dynamic_free(__mem, __arr) ((void)(__mem), (void)(__arr))
+
+    #else
+
+        /**
+         * Allocates an empty array for `__arr` from `__mem`, a
+         * `struct ca_memory*`, and evaluates to it.
+         */
+        #define ca_dynamic_new(__mem, __arr, __len, __cap)                     \
+            (__len = 0, __cap = 16,                                            \
+                (__arr) = ca_memory_alloc(__mem, sizeof(*(__arr)) * (__cap)))
+
+        /**
+         * Appends `__newelem`, growing the array from `__mem` if needed.
+         * Evaluates to zero on success and nonzero if the array could not
+         * grow, in which case it is left unchanged and `errno` is set.
+         *
+         * @pre `__arrptr` has been allocated with ca_dynamic_new().
+         */
+        #define ca_dynamic_push(__mem, __arrptr, __len, __cap, __newelem)      \
+            (ca_dynamic_reserve(__mem, __arrptr, sizeof(**(__arrptr)),         \
+                 (__len) + 1, &(__cap))                                        \
+                    ? 1                                                        \
+                    : ((*(__arrptr))[(__len)++] = (__newelem), 0))
+
+        /** Releases an array allocated with ca_dynamic_new() from `__mem`. */
+        #define ca_dynamic_free(__mem, __arr) ca_memory_free(__mem, __arr)
+
+    #endif
 
 #endif
@@ -0,0 +1,260 @@
+/**
+ * \file fallback.c
+ * \brief Filling in options from the environment and a config file.
+ * \copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ * \author Ethan Uppal
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+
+#define CA_PRIVATE_SRC
+#include "cmdapp.h"
+#include "dynarr.h"
+#undef CA_PRIVATE_SRC
+
+extern char** environ;
+
+/**
+ * Whether the `length` bytes of `name` spell the environment variable of the
+ * long option `long_opt`, which is it in uppercase with `-` as `_`.
+ */
+static bool ca_is_env_name(const char* long_opt, const char* name,
+    size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char c = long_opt[i];
+        if (c == '\0'
+            || (c == '-' ? '_' : (char)toupper((unsigned char)c)) != name[i]) {
+            return false;
+        }
+    }
+    return long_opt[length] == '\0';
+}
+
+/**
+ * Finds the option whose environment variable is named by the `length` bytes
+ * of `name`, or `CA_NO_OPT` if there is none.
+ */
+static int ca_lookup_env_name(struct ca_parse_state* state, const char* name,
+    size_t length) {
+    // undo the mapping for an option spelled in lowercase, which is looked up
+    // in the long option table; a lowercase letter or `-` is never mapped to
+    char long_opt[CA_MAX_ENV_NAME];
+    for (size_t i = 0; i < length; i++) {
+        char c = name[i];
+        if (c == '-' || islower((unsigned char)c)) {
+            return CA_NO_OPT;
+        }
+        long_opt[i] = c == '_' ? '-' : (char)tolower((unsigned char)c);
+    }
+    int opt = ca_state_lookup_long(state, long_opt, length);
+    if (opt != CA_NO_OPT) {
+        return opt;
+    }
+
+    // otherwise it may be an option with uppercase letters or underscores
+    const struct ca_schema* schema = state->schema;
+    for (size_t i = 0; i < schema->options_length; i++) {
+        if (ca_is_env_name(schema->options[i].long_opt, name, length)) {
+            return (int)i;
+        }
+    }
+    return CA_NO_OPT;
+}
+
+/** Whether `c` is whitespace within a line. */
+static bool ca_is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/** Records that `arg` was given for the option `opt`, unless there is none. */
+static int ca_add_fallback(struct ca_parse_state* state, int opt,
+    const char* arg) {
+    if (opt == CA_NO_OPT) {
+        return 0;
+    }
+    struct ca_fallback fallback = {opt, arg};
+    return ca_dynamic_push(state->memory, &state->fallbacks,
+        state->fallbacks_length, state->fallbacks_capacity, fallback);
+}
+
+/**
+ * Reads the options named by the variables with the environment prefix of
+ * the schema of `state`, in one pass over the environment.
+ */
+static int ca_read_env(struct ca_parse_state* state) {
+    const char* prefix = state->schema->env_prefix;
+    size_t prefix_length = strlen(prefix);
+    for (char** var = environ; *var; var++) {
+        const char* entry = *var;
+        if (strncmp(entry, prefix, prefix_length) != 0) {
+            continue;
+        }
+
+        // the rest of the variable name is the option's name mapped
+        const char* name = entry + prefix_length;
+        const char* value = strchr(name, '=');
+        if (!value || (size_t)(value - name) > CA_MAX_ENV_NAME) {
+            continue;
+        }
+        int opt = ca_lookup_env_name(state, name, (size_t)(value - name));
+
+        // the value stays in the environment, so it is used as is
+        if (ca_add_fallback(state, opt, value + 1) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reads the options named by the config file of the schema of `state`,
+ * splitting its lines in place. A file that cannot be read is recorded in
+ * `state->config_error` rather than failing.
+ */
+static int ca_read_config(struct ca_parse_state* state) {
+    if (ca_response_load(state, state->schema->config_path, &state->config)
+        != 0) {
+        state->config_error = errno == ENOENT ? 0 : errno;
+        return 0;
+    }
+    state->has_config = true;
+
+    char* end = state->config.data + state->config.size;
+    for (char* line = state->config.data; line < end;) {
+        char* line_end = memchr(line, '\n', (size_t)(end - line));
+        if (!line_end) {
+            line_end = end;
+        }
+        char* next = line_end + 1;
+
+        while (line < line_end && ca_is_blank(*line)) {
+            line++;
+        }
+        while (line_end > line && ca_is_blank(line_end[-1])) {
+            line_end--;
+        }
+        if (line == line_end || *line == '#') {
+            line = next;
+            continue;
+        }
+
+        // the name ends at `=` or the end of the line, and the argument
+        // after it is terminated where the line ends, which is always
+        // writable since the file has a spare byte after it
+        char* equals = memchr(line, '=', (size_t)(line_end - line));
+        char* name_end = equals ? equals : line_end;
+        while (name_end > line && ca_is_blank(name_end[-1])) {
+            name_end--;
+        }
+        char* arg = NULL;
+        if (equals) {
+            arg = equals + 1;
+            while (arg < line_end && ca_is_blank(*arg)) {
+                arg++;
+            }
+            *line_end = '\0';
+        }
+        int opt = ca_state_lookup_long(state, line,
+            (size_t)(name_end - line));
+        if (ca_add_fallback(state, opt, arg) != 0) {
+            return 1;
+        }
+        line = next;
+    }
+    return 0;
+}
+
+/**
+ * Reads what the environment and config file of the schema of `state` name,
+ * unless that was already read for the schema as it is now. Sets `errno` on
+ * failure.
+ *
+ * @returns Zero on success, nonzero on failure.
+ */
+static int ca_read_fallbacks(struct ca_parse_state* state) {
+    const struct ca_schema* schema = state->schema;
+    if (state->fallbacks_read
+        && state->fallbacks_options == schema->options_length
+        && state->fallbacks_prefix == schema->env_prefix
+        && state->fallbacks_path == schema->config_path) {
+        return 0;
+    }
+    ca_state_drop_fallbacks(state);
+    if (!state->fallbacks
+        && !ca_dynamic_new(state->memory, state->fallbacks,
+            state->fallbacks_length, state->fallbacks_capacity)) {
+        errno = ENOMEM;
+        return 1;
+    }
+
+    // the environment precedes the config file, which it takes precedence
+    // over
+    if (schema->env_prefix && ca_read_env(state) != 0) {
+        return 1;
+    }
+    state->env_fallbacks = state->fallbacks_length;
+    if (schema->config_path && ca_read_config(state) != 0) {
+        return 1;
+    }
+    state->fallbacks_read = true;
+    state->fallbacks_options = schema->options_length;
+    state->fallbacks_prefix = schema->env_prefix;
+    state->fallbacks_path = schema->config_path;
+    return 0;
+}
+
+/**
+ * Passes the options `fallbacks[begin, end)` of `state` that were not passed
+ * before them.
+ */
+static int ca_apply_fallbacks(struct ca_parse_state* state, size_t begin,
+    size_t end) {
+    size_t earlier = state->passed_length;
+    for (size_t i = begin; i < end; i++) {
+        const struct ca_fallback* fallback = &state->fallbacks[i];
+        if (ca_state_fill(state, fallback->opt, fallback->arg, earlier) != 0
+            && state->halted) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int ca_state_fill_fallbacks(struct ca_parse_state* state) {
+    if (!state->schema->env_prefix && !state->schema->config_path) {
+        return 0;
+    }
+    if (ca_read_fallbacks(state) != 0) {
+        ca_state_drop_fallbacks(state);
+        ca_report_error(state, CA_ERROR_NO_MEMORY, CA_NO_OPT, -1,
+            "out of memory\n");
+        return 1;
+    }
+
+    // the environment takes precedence over the config file
+    if (ca_apply_fallbacks(state, 0, state->env_fallbacks) != 0) {
+        return 1;
+    }
+    if (state->config_error != 0) {
+        ca_report_error(state, CA_ERROR_FILE, CA_NO_OPT, -1,
+            "cannot read config file %s: %s\n", state->schema->config_path,
+            strerror(state->config_error));
+        return 1;
+    }
+    return ca_apply_fallbacks(state, state->env_fallbacks,
+        state->fallbacks_length);
+}
+
+void ca_state_drop_fallbacks(struct ca_parse_state* state) {
+    if (state->has_config) {
+        ca_response_release(state, &state->config);
+        state->has_config = false;
+    }
+    state->config_error = 0;
+    state->fallbacks_length = 0;
+    state->env_fallbacks = 0;
+    state->fallbacks_read = false;
+}
@@ -0,0 +1,184 @@
+/**
+ * \file memory.c
+ * \brief Allocation through the user allocator and the bump arena.
+ * \copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ * \author Ethan Uppal
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#define CA_PRIVATE_SRC
+#include "cmdapp.h"
+#include "stats.h"
+#undef CA_PRIVATE_SRC
+
+static void* ca_default_alloc(size_t size, void* user) {
+    (void)user;
+    return malloc(size);
+}
+
+static void* ca_default_realloc(void* ptr, size_t size, void* user) {
+    (void)user;
+    return realloc(ptr, size);
+}
+
+static void ca_default_free(void* ptr, void* user) {
+    (void)user;
+    free(ptr);
+}
+
+/** The allocator given to new contexts; see ca_set_allocator(). */
+static struct ca_allocator ca_allocator = {ca_default_alloc,
+    ca_default_realloc, ca_default_free, NULL};
+
+/** The arena size given to new contexts; see ca_set_arena(). */
+static size_t ca_arena_hint = CA_ARENA_DEFAULT;
+
+void ca_set_allocator(const struct ca_allocator* allocator) {
+    if (allocator && allocator->alloc && allocator->realloc
+        && allocator->free) {
+        ca_allocator = *allocator;
+    } else {
+        ca_allocator.alloc = ca_default_alloc;
+        ca_allocator.realloc = ca_default_realloc;
+        ca_allocator.free = ca_default_free;
+        ca_allocator.user = NULL;
+    }
+}
+
+void ca_set_arena(size_t size_hint) {
+    ca_arena_hint = size_hint;
+}
+
+/** Rounds `size` up to a multiple of `CA_ARENA_ALIGN`. */
+static size_t ca_arena_round(size_t size) {
+    return (size + CA_ARENA_ALIGN - 1) & ~(size_t)(CA_ARENA_ALIGN - 1);
+}
+
+/** Whether `ptr` was carved out of the arena of `memory`. */
+static bool ca_arena_owns(const struct ca_memory* memory, const void* ptr) {
+    const char* p = ptr;
+    return memory->arena && p >= memory->arena
+           && p < memory->arena + memory->arena_capacity;
+}
+
+int ca_memory_init(struct ca_memory* memory, bool use_arena) {
+    memory->allocator = ca_allocator;
+    memory->arena = NULL;
+    memory->arena_capacity = 0;
+    memory->arena_length = 0;
+    memory->arena_last = NULL;
+#ifdef CA_STATS
+    memset(&memory->stats, 0, sizeof(memory->stats));
+#endif
+
+#ifdef CA_STATIC_CAPACITY
+    // every array is in fixed storage, so an arena would go unused
+    (void)use_arena;
+#else
+    if (use_arena && ca_arena_hint > 0) {
+        size_t capacity = ca_arena_round(ca_arena_hint);
+        memory->arena = memory->allocator.alloc(capacity,
+            memory->allocator.user);
+        if (!memory->arena) {
+            errno = ENOMEM;
+            return 1;
+        }
+        memory->arena_capacity = capacity;
+        ca_stat_add(memory, bytes_allocated, capacity);
+    }
+#endif
+    return 0;
+}
+
+void ca_memory_deinit(struct ca_memory* memory) {
+    // everything carved out of the arena goes with it
+    if (memory->arena) {
+        memory->allocator.free(memory->arena, memory->allocator.user);
+        memory->arena = NULL;
+    }
+}
+
+void* ca_memory_alloc(struct ca_memory* memory, size_t size) {
+    ca_stat_add(memory, bytes_allocated, size);
+    if (memory->arena) {
+        size_t rounded = ca_arena_round(size);
+        if (rounded <= memory->arena_capacity - memory->arena_length) {
+            void* ptr = memory->arena + memory->arena_length;
+            memory->arena_length += rounded;
+            memory->arena_last = ptr;
+            return ptr;
+        }
+    }
+
+    // the arena is full or disabled
+    return memory->allocator.alloc(size, memory->allocator.user);
+}
+
+void* ca_memory_realloc(struct ca_memory* memory, void* ptr, size_t old_size,
+    size_t new_size) {
+    if (!ptr) {
+        return ca_memory_alloc(memory, new_size);
+    }
+    if (!ca_arena_owns(memory, ptr)) {
+        ca_stat_add(memory, bytes_allocated,
+            new_size > old_size ? new_size - old_size : 0);
+        return memory->allocator.realloc(ptr, new_size,
+            memory->allocator.user);
+    }
+
+    // the most recent arena allocation can grow in place
+    if (ptr == memory->arena_last) {
+        size_t offset = (size_t)((char*)ptr - memory->arena);
+        size_t rounded = ca_arena_round(new_size);
+        if (rounded <= memory->arena_capacity - offset) {
+            memory->arena_length = offset + rounded;
+            ca_stat_add(memory, bytes_allocated,
+                new_size > old_size ? new_size - old_size : 0);
+            return ptr;
+        }
+    }
+
+    // otherwise move it, leaving the old space unused until the arena goes
+    void* moved = ca_memory_alloc(memory, new_size);
+    if (moved) {
+        memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return moved;
+}
+
+void ca_memory_free(struct ca_memory* memory, void* ptr) {
+    if (ptr && !ca_arena_owns(memory, ptr)) {
+        memory->allocator.free(ptr, memory->allocator.user);
+    }
+}
+
+int ca_dynamic_reserve(struct ca_memory* memory, void* arrptr,
+    size_t elem_size, size_t length, size_t* cap) {
+    if (length < *cap) {
+        return 0;
+    }
+
+    // `arrptr` points to an array pointer of any type, so it is accessed
+    // bytewise
+    void* array;
+    memcpy(&array, arrptr, sizeof(array));
+    // an array may start out empty, which doubling alone would never grow
+    size_t new_cap = *cap ? *cap * 2 : 16;
+    while (new_cap <= length) {
+        new_cap *= 2;
+    }
+    void* grown = ca_memory_realloc(memory, array, elem_size * *cap,
+        elem_size * new_cap);
+    if (!grown) {
+        errno = ENOMEM;
+        return 1;
+    }
+    memcpy(arrptr, &grown, sizeof(grown));
+    *cap = new_cap;
+    ca_stat_add(memory, reallocs, 1);
+    return 0;
+}
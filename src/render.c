@@ -0,0 +1,592 @@
+/**
+ * \file render.c
+ * \brief Laying out help and version information as text.
+ * \copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ * \author Ethan Uppal
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <errno.h>
+
+#define CA_PRIVATE_SRC
+#include "cmdapp.h"
+#include "dynarr.h"
+#undef CA_PRIVATE_SRC
+
+void ca_text_init(struct ca_text* text, char* data, size_t capacity,
+    FILE* out) {
+    text->data = data;
+    text->capacity = data ? capacity : 0;
+    text->used = 0;
+    text->length = 0;
+    text->out = out;
+}
+
+void ca_text_append(struct ca_text* text, const char* str, size_t length) {
+    text->length += length;
+    while (length > 0) {
+        if (text->used == text->capacity) {
+            // without a stream, the rest is only counted
+            if (!text->out || text->capacity == 0) {
+                return;
+            }
+            ca_text_flush(text);
+        }
+        size_t room = text->capacity - text->used;
+        size_t take = length < room ? length : room;
+        memcpy(text->data + text->used, str, take);
+        text->used += take;
+        str += take;
+        length -= take;
+    }
+}
+
+void ca_text_puts(struct ca_text* text, const char* str) {
+    ca_text_append(text, str, strlen(str));
+}
+
+/** Appends `count` spaces to `text`. */
+static void ca_text_pad(struct ca_text* text, size_t count) {
+    static const char spaces[] = "                                ";
+    while (count > 0) {
+        size_t take = count < sizeof(spaces) - 1 ? count : sizeof(spaces) - 1;
+        ca_text_append(text, spaces, take);
+        count -= take;
+    }
+}
+
+/** Appends `n` in decimal to `text`. */
+static void ca_text_int(struct ca_text* text, int n) {
+    char digits[16];
+    int length = snprintf(digits, sizeof(digits), "%d", n);
+    ca_text_append(text, digits, (size_t)length);
+}
+
+void ca_text_flush(struct ca_text* text) {
+    if (text->out && text->used > 0) {
+        fwrite(text->data, 1, text->used, text->out);
+    }
+    text->used = 0;
+}
+
+/** Returns the current year or `CA_NO_YEAR` on failure. */
+static int ca_get_current_year(void) {
+    // https://stackoverflow.com/questions/1442116/how-to-get-the-date-and-time-values-in-a-c-program
+    time_t current_time = time(NULL);
+    if (current_time == (time_t)-1) {
+        return CA_NO_YEAR;
+    }
+
+    // localtime() shares its result between threads
+    struct tm current_localtime;
+#ifdef CA_ON_UNIX
+    if (localtime_r(&current_time, &current_localtime) == NULL) {
+        return CA_NO_YEAR;
+    }
+#else
+    struct tm* tmp = localtime(&current_time);
+    if (tmp == NULL) {
+        return CA_NO_YEAR;
+    }
+    current_localtime = *tmp;
+#endif
+
+    return current_localtime.tm_year + 1900 /* base year for time */;
+}
+
+static void render_authors(const struct ca_schema* schema,
+    struct ca_text* text) {
+    switch (schema->authors_length) {
+        case 1:
+            ca_text_puts(text, schema->authors[0]);
+            break;
+        case 2:
+            ca_text_puts(text, schema->authors[0]);
+            ca_text_puts(text, " and ");
+            ca_text_puts(text, schema->authors[1]);
+            break;
+        default: {
+            for (size_t i = 0; i < schema->authors_length; i++) {
+                if (i) {
+                    ca_text_puts(text, ", ");
+                }
+                if (i + 1 == schema->authors_length) {
+                    ca_text_puts(text, "and ");
+                }
+                ca_text_puts(text, schema->authors[i]);
+            }
+            break;
+        }
+    }
+}
+
+void ca_render_version_text(const struct ca_schema* schema,
+    struct ca_text* text) {
+    if (schema->version_text) {
+        ca_text_append(text, schema->version_text, schema->version_length);
+        return;
+    }
+
+    // print program and version number
+    ca_text_puts(text, schema->program);
+    ca_text_puts(text, " ");
+    ca_text_int(text, schema->ver_major);
+    ca_text_puts(text, ".");
+    ca_text_int(text, schema->ver_minor);
+    ca_text_puts(text, ".");
+    ca_text_int(text, schema->ver_patch);
+    ca_text_puts(text, "\n");
+
+    // rest of the prints use authors
+    if (schema->authors_length == 0) {
+        return;
+    }
+
+    // print copyright
+    ca_text_puts(text, "\nCopyright (C) ");
+    // if no year is specified, do not print any
+    // if one is specified, compare with current year
+    // if they are the same, just print one year
+    // if they are different, print them both separated with a dash
+    if (schema->year != CA_NO_YEAR) {
+        int current_year = ca_get_current_year();
+        ca_text_int(text, schema->year);
+        if (current_year != CA_NO_YEAR && schema->year != current_year) {
+            ca_text_puts(text, "-");
+            ca_text_int(text, current_year);
+        }
+        ca_text_puts(text, " ");
+    }
+    render_authors(schema, text);
+    ca_text_puts(text, ".");
+
+    // print additional versioning information
+    if (schema->ver_info) {
+        ca_text_puts(text, " ");
+        ca_text_puts(text, schema->ver_info);
+    }
+
+    // print authorship
+    ca_text_puts(text, "\n\nWritten by ");
+    render_authors(schema, text);
+    ca_text_puts(text, ".\n");
+}
+
+/** The length of the name of the argument of `opt` in `--help`. */
+static size_t ca_arg_name_length(const struct ca_opt* opt) {
+    size_t length = 0;
+    while (isalpha(opt->arg_name[length])) {
+        length++;
+    }
+    return length;
+}
+
+void ca_render_help_text(const struct ca_schema* schema,
+    struct ca_text* text) {
+    if (schema->help_text) {
+        ca_text_append(text, schema->help_text, schema->help_length);
+        return;
+    }
+
+    // keep track of whether a section has been printed so extra space can be
+    // added for separation
+    bool previous_print = false;
+
+    // print description
+    if (schema->description) {
+        ca_text_puts(text, schema->description);
+        ca_text_puts(text, "\n");
+        previous_print = true;
+    }
+
+    // print synopses
+    if (schema->synopses_length > 0) {
+        if (previous_print) ca_text_puts(text, "\n");
+        for (size_t i = 0; i < schema->synopses_length; i++) {
+            ca_text_puts(text, i == 0 ? "Usage: " : "   or: ");
+            ca_text_puts(text, schema->program);
+            ca_text_puts(text, " ");
+            ca_text_puts(text, schema->synopses[i]);
+            ca_text_puts(text, "\n");
+        }
+        previous_print = true;
+    }
+
+    // print options
+    if (schema->options_length > 0) {
+        if (previous_print) ca_text_puts(text, "\n");
+        ca_text_puts(text, "Options:\n");
+        for (size_t i = 0; i < schema->options_length; i++) {
+            const struct ca_opt* opt = &schema->options[i];
+            const struct ca_opt_hot* hot = &schema->hot[i];
+
+            // print the short option
+            if (hot->short_opt != '\0') {
+                char short_opt[] = {' ', '-', hot->short_opt, ',', ' '};
+                ca_text_append(text, short_opt, sizeof(short_opt));
+            } else {
+                ca_text_pad(text, sizeof("      ") - 1);
+            }
+
+            // print the long option with arg if necessary, measuring it first
+            // to find the column of the description
+            size_t width = sizeof("--") - 1 + strlen(opt->long_opt);
+            ca_text_puts(text, "--");
+            ca_text_puts(text, opt->long_opt);
+            if (hot->flags & CA_OPT_ARG) {
+                size_t arg_name_length = ca_arg_name_length(opt);
+                width += sizeof("[=]") - 1 + arg_name_length;
+                ca_text_puts(text, "[=");
+                ca_text_append(text, opt->arg_name, arg_name_length);
+                ca_text_puts(text, "]");
+            }
+
+            // if past the offset for printing descriptions, put description on
+            // new line, otherwise print description afterward
+            size_t used = width + (sizeof("      ") - 1);
+            if (used + 1 /* prevents right next to each other */
+                > CA_DESCRIPTION_OFFSET) {
+                ca_text_puts(text, "\n");
+                ca_text_pad(text, CA_DESCRIPTION_OFFSET - 1);
+            } else {
+                ca_text_pad(text, CA_DESCRIPTION_OFFSET - used);
+            }
+            if (opt->description) {
+                ca_text_puts(text, opt->description);
+            }
+            ca_text_puts(text, "\n");
+        }
+        previous_print = true;
+    }
+
+    // print subcommands, with their descriptions in the same column
+    if (schema->subcommands_length > 0) {
+        if (previous_print) ca_text_puts(text, "\n");
+        ca_text_puts(text, "Commands:\n");
+        for (size_t i = 0; i < schema->subcommands_length; i++) {
+            const struct ca_subcommand* subcommand = &schema->subcommands[i];
+            size_t used = sizeof("  ") - 1 + strlen(subcommand->name);
+            ca_text_puts(text, "  ");
+            ca_text_puts(text, subcommand->name);
+            if (used + 1 > CA_DESCRIPTION_OFFSET) {
+                ca_text_puts(text, "\n");
+                ca_text_pad(text, CA_DESCRIPTION_OFFSET - 1);
+            } else {
+                ca_text_pad(text, CA_DESCRIPTION_OFFSET - used);
+            }
+            if (subcommand->description) {
+                ca_text_puts(text, subcommand->description);
+            }
+            ca_text_puts(text, "\n");
+        }
+        previous_print = true;
+    }
+}
+
+/**
+ * Appends `str` to `text` as roff, which reads a backslash as an escape and a
+ * leading `.` or `'` as a request. Hyphens are escaped too if `literal`, so
+ * that they are not broken or typeset as dashes.
+ */
+static void ca_text_roff(struct ca_text* text, const char* str, bool literal) {
+    bool line_start = true;
+    const char* run = str;
+    for (const char* p = str; *p; p++) {
+        const char* escape = NULL;
+        if (*p == '\\') {
+            escape = "\\e";
+        } else if (line_start && (*p == '.' || *p == '\'')) {
+            escape = *p == '.' ? "\\&." : "\\&'";
+        } else if (literal && *p == '-') {
+            escape = "\\-";
+        }
+        if (escape) {
+            ca_text_append(text, run, (size_t)(p - run));
+            ca_text_puts(text, escape);
+            run = p + 1;
+        }
+        line_start = *p == '\n';
+    }
+    ca_text_puts(text, run);
+}
+
+/** The name of the program of `schema`, without its directory. */
+static const char* ca_program_name(const struct ca_schema* schema) {
+    const char* slash = strrchr(schema->program, '/');
+    return slash ? slash + 1 : schema->program;
+}
+
+void ca_render_man_text(const struct ca_schema* schema, struct ca_text* text) {
+    const char* name = ca_program_name(schema);
+
+    // the title is the program name in capitals, as help2man writes it
+    ca_text_puts(text, ".TH ");
+    for (const char* p = name; *p; p++) {
+        char upper = (char)toupper((unsigned char)*p);
+        if (upper == '\\' || upper == ' ' || upper == '"') {
+            upper = '_';
+        }
+        ca_text_append(text, &upper, 1);
+    }
+    ca_text_puts(text, " 1 \"");
+    if (schema->year != CA_NO_YEAR) {
+        ca_text_int(text, schema->year);
+    }
+    ca_text_puts(text, "\" \"");
+    ca_text_roff(text, name, true);
+    ca_text_puts(text, " ");
+    ca_text_int(text, schema->ver_major);
+    ca_text_puts(text, ".");
+    ca_text_int(text, schema->ver_minor);
+    ca_text_puts(text, ".");
+    ca_text_int(text, schema->ver_patch);
+    ca_text_puts(text, "\" \"User Commands\"\n");
+
+    ca_text_puts(text, ".SH NAME\n");
+    ca_text_roff(text, name, true);
+    if (schema->description) {
+        ca_text_puts(text, " \\- ");
+        ca_text_roff(text, schema->description, false);
+    }
+    ca_text_puts(text, "\n");
+
+    if (schema->synopses_length > 0) {
+        ca_text_puts(text, ".SH SYNOPSIS\n");
+        for (size_t i = 0; i < schema->synopses_length; i++) {
+            if (i > 0) {
+                ca_text_puts(text, ".br\n");
+            }
+            ca_text_puts(text, ".B ");
+            ca_text_roff(text, name, true);
+            ca_text_puts(text, "\n");
+            ca_text_roff(text, schema->synopses[i], false);
+            ca_text_puts(text, "\n");
+        }
+    }
+
+    if (schema->description) {
+        ca_text_puts(text, ".SH DESCRIPTION\n");
+        ca_text_roff(text, schema->description, false);
+        ca_text_puts(text, "\n");
+    }
+
+    if (schema->options_length > 0) {
+        ca_text_puts(text, ".SH OPTIONS\n");
+        for (size_t i = 0; i < schema->options_length; i++) {
+            const struct ca_opt* opt = &schema->options[i];
+            const struct ca_opt_hot* hot = &schema->hot[i];
+            ca_text_puts(text, ".TP\n");
+            if (hot->short_opt != '\0') {
+                char short_opt[] = {'\\', 'f', 'B', '\\', '-',
+                    hot->short_opt};
+                ca_text_append(text, short_opt, sizeof(short_opt));
+                ca_text_puts(text, "\\fR, ");
+            }
+            ca_text_puts(text, "\\fB\\-\\-");
+            ca_text_roff(text, opt->long_opt, true);
+            ca_text_puts(text, "\\fR");
+            if (hot->flags & CA_OPT_ARG) {
+                ca_text_puts(text, "[=\\fI");
+                ca_text_append(text, opt->arg_name, ca_arg_name_length(opt));
+                ca_text_puts(text, "\\fR]");
+            }
+            ca_text_puts(text, "\n");
+            if (opt->description) {
+                ca_text_roff(text, opt->description, false);
+            }
+            ca_text_puts(text, "\n");
+        }
+    }
+
+    if (schema->subcommands_length > 0) {
+        ca_text_puts(text, ".SH COMMANDS\n");
+        for (size_t i = 0; i < schema->subcommands_length; i++) {
+            const struct ca_subcommand* subcommand = &schema->subcommands[i];
+            ca_text_puts(text, ".TP\n\\fB");
+            ca_text_roff(text, subcommand->name, true);
+            ca_text_puts(text, "\\fR\n");
+            if (subcommand->description) {
+                ca_text_roff(text, subcommand->description, false);
+            }
+            ca_text_puts(text, "\n");
+        }
+    }
+
+    if (schema->authors_length > 0) {
+        ca_text_puts(text, ".SH AUTHOR\nWritten by ");
+        render_authors(schema, text);
+        ca_text_puts(text, ".\n");
+
+        ca_text_puts(text, ".SH COPYRIGHT\nCopyright \\(co ");
+        if (schema->year != CA_NO_YEAR) {
+            ca_text_int(text, schema->year);
+            ca_text_puts(text, " ");
+        }
+        render_authors(schema, text);
+        ca_text_puts(text, ".");
+        if (schema->ver_info) {
+            ca_text_puts(text, " ");
+            ca_text_roff(text, schema->ver_info, false);
+        }
+        ca_text_puts(text, "\n");
+    }
+}
+
+/**
+ * Appends the program name of `schema` to `text` with every character that
+ * cannot be in a shell function name replaced by `_`.
+ */
+static void ca_text_shell_name(struct ca_text* text,
+    const struct ca_schema* schema) {
+    for (const char* p = ca_program_name(schema); *p; p++) {
+        char c = isalnum((unsigned char)*p) ? *p : '_';
+        ca_text_append(text, &c, 1);
+    }
+}
+
+void ca_render_completion_text(const struct ca_schema* schema,
+    enum ca_shell shell, struct ca_text* text) {
+    const char* name = ca_program_name(schema);
+
+    // each script hands the words to --ca-complete and lets the shell fall
+    // back to file names when nothing comes back
+    switch (shell) {
+        case CA_SHELL_BASH: {
+            ca_text_puts(text, "_");
+            ca_text_shell_name(text, schema);
+            ca_text_puts(text,
+                "_complete() {\n"
+                "    local IFS=$'\\n'\n"
+                "    COMPREPLY=($(\"${COMP_WORDS[0]}\" --ca-complete "
+                "\"$COMP_CWORD\" \\\n"
+                "        \"${COMP_WORDS[@]}\" 2>/dev/null))\n"
+                "}\n"
+                "complete -o default -F _");
+            ca_text_shell_name(text, schema);
+            ca_text_puts(text, "_complete ");
+            ca_text_puts(text, name);
+            ca_text_puts(text, "\n");
+            break;
+        }
+        case CA_SHELL_ZSH: {
+            ca_text_puts(text, "#compdef ");
+            ca_text_puts(text, name);
+            ca_text_puts(text, "\n_");
+            ca_text_shell_name(text, schema);
+            ca_text_puts(text,
+                "() {\n"
+                "    local -a replies\n"
+                "    replies=(${(f)\"$(\"${words[1]}\" --ca-complete "
+                "$((CURRENT - 1)) \\\n"
+                "        \"${words[@]}\" 2>/dev/null)\"})\n"
+                "    if (( ${#replies} )); then\n"
+                "        compadd -a replies\n"
+                "    else\n"
+                "        _files\n"
+                "    fi\n"
+                "}\n"
+                "if [ \"$funcstack[1]\" = \"_");
+            ca_text_shell_name(text, schema);
+            ca_text_puts(text, "\" ]; then\n    _");
+            ca_text_shell_name(text, schema);
+            ca_text_puts(text, " \"$@\"\nelse\n    compdef _");
+            ca_text_shell_name(text, schema);
+            ca_text_puts(text, " ");
+            ca_text_puts(text, name);
+            ca_text_puts(text, "\nfi\n");
+            break;
+        }
+        case CA_SHELL_FISH: {
+            ca_text_puts(text, "function __");
+            ca_text_shell_name(text, schema);
+            ca_text_puts(text,
+                "_complete\n"
+                "    set -l words (commandline -opc) (commandline -ct)\n"
+                "    $words[1] --ca-complete (math (count $words) - 1) "
+                "$words\n"
+                "end\n"
+                "complete -c ");
+            ca_text_puts(text, name);
+            ca_text_puts(text, " -a '(__");
+            ca_text_shell_name(text, schema);
+            ca_text_puts(text, "_complete)'\n");
+            break;
+        }
+    }
+}
+
+int ca_cache_text(struct ca_schema* schema, struct ca_text_cache* cache,
+    void (*render)(const struct ca_schema*, struct ca_text*)) {
+    if (cache->valid) {
+        return 0;
+    }
+
+    // measure first, so that the text is laid out once into a buffer that
+    // fits it
+    struct ca_text text;
+    ca_text_init(&text, NULL, 0, NULL);
+    render(schema, &text);
+    size_t size = text.length + 1;
+#ifdef CA_STATIC_CAPACITY
+    (void)schema;
+    if (size > sizeof(cache->data_storage)) {
+        errno = ENOMEM;
+        return 1;
+    }
+    cache->data = cache->data_storage;
+#else
+    if (cache->capacity < size) {
+        char* data = ca_memory_realloc(&schema->memory, cache->data,
+            cache->capacity, size);
+        if (!data) {
+            errno = ENOMEM;
+            return 1;
+        }
+        cache->data = data;
+        cache->capacity = size;
+    }
+#endif
+    ca_text_init(&text, cache->data, size, NULL);
+    render(schema, &text);
+    cache->data[text.length] = '\0';
+    cache->length = text.length;
+    cache->valid = true;
+    return 0;
+}
+
+void ca_print_text(const struct ca_schema* schema,
+    const struct ca_text_cache* cache,
+    void (*render)(const struct ca_schema*, struct ca_text*)) {
+    if (cache && cache->valid) {
+        fwrite(cache->data, 1, cache->length, stdout);
+        return;
+    }
+
+    // lay it out in pieces if it could not be cached
+    char buffer[512];
+    struct ca_text text;
+    ca_text_init(&text, buffer, sizeof(buffer), stdout);
+    render(schema, &text);
+    ca_text_flush(&text);
+}
+
+size_t ca_copy_text(struct ca_schema* schema, struct ca_text_cache* cache,
+    void (*render)(const struct ca_schema*, struct ca_text*), char* buffer,
+    size_t capacity) {
+    // one byte is left for the terminator
+    struct ca_text text;
+    ca_text_init(&text, buffer, capacity > 0 ? capacity - 1 : 0, NULL);
+    if (cache && ca_cache_text(schema, cache, render) == 0) {
+        ca_text_append(&text, cache->data, cache->length);
+    } else {
+        render(schema, &text);
+    }
+    if (capacity > 0) {
+        buffer[text.used] = '\0';
+    }
+    return text.length;
+}
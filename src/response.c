@@ -0,0 +1,161 @@
+/**
+ * \file response.c
+ * \brief Reading arguments from response files given as `@path`.
+ * \copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ * \author Ethan Uppal
+ */
+
+// anonymous mappings are not part of POSIX proper
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <errno.h>
+
+#define CA_PRIVATE_SRC
+#include "cmdapp.h"
+#include "dynarr.h"
+#undef CA_PRIVATE_SRC
+
+#ifdef CA_ON_UNIX
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #ifndef MAP_ANONYMOUS
+        #define MAP_ANONYMOUS MAP_ANON
+    #endif
+#endif
+
+int ca_response_load(struct ca_parse_state* state, const char* path,
+    struct ca_response* response) {
+#ifdef CA_ON_UNIX
+    (void)state;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return 1;
+    }
+    size_t size = (size_t)info.st_size;
+
+    // reserve whole pages of zeros first, since a file that ends on a page
+    // boundary leaves no spare byte after its mapping
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t length = (size + 1 + page - 1) / page * page;
+    char* data = mmap(NULL, length, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return 1;
+    }
+
+    // the mapping is private, so tokens are terminated without touching the
+    // file itself
+    if (size > 0
+        && mmap(data, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+               fd, 0)
+               == MAP_FAILED) {
+        int error = errno;
+        munmap(data, length);
+        close(fd);
+        errno = error;
+        return 1;
+    }
+    close(fd);
+
+    response->data = data;
+    response->size = size;
+    response->length = length;
+    return 0;
+#else
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return 1;
+    }
+    size_t capacity = 4096;
+    size_t size = 0;
+    char* data = ca_memory_alloc(state->memory, capacity);
+    while (data) {
+        size += fread(data + size, 1, capacity - size, file);
+        if (size < capacity) {
+            break;
+        }
+        char* grown = ca_memory_realloc(state->memory, data, capacity,
+            capacity * 2);
+        if (!grown) {
+            ca_memory_free(state->memory, data);
+        }
+        data = grown;
+        capacity *= 2;
+    }
+    bool failed = !data || ferror(file);
+    fclose(file);
+    if (failed) {
+        if (data) {
+            ca_memory_free(state->memory, data);
+        }
+        errno = data ? EIO : ENOMEM;
+        return 1;
+    }
+
+    data[size] = '\0';
+    response->data = data;
+    response->size = size;
+    response->length = capacity;
+    return 0;
+#endif
+}
+
+void ca_response_release(struct ca_parse_state* state,
+    struct ca_response* response) {
+#ifdef CA_ON_UNIX
+    (void)state;
+    munmap(response->data, response->length);
+#else
+    ca_memory_free(state->memory, response->data);
+#endif
+}
+
+char* ca_response_map(struct ca_parse_state* state, const char* path,
+    size_t* size) {
+    struct ca_response response;
+    if (ca_response_load(state, path, &response) != 0) {
+        return NULL;
+    }
+
+    // what is read points into the file, so it stays loaded until the next
+    // parse
+    if (ca_dynamic_push(state->memory, &state->responses,
+            state->responses_length, state->responses_capacity, response)
+        != 0) {
+        ca_response_release(state, &response);
+        return NULL;
+    }
+    *size = response.size;
+    return response.data;
+}
+
+int ca_response_open(struct ca_parse_state* state, const char* path) {
+    size_t size;
+    char* data = ca_response_map(state, path, &size);
+    if (!data) {
+        return 1;
+    }
+    state->tokens = data;
+    state->tokens_end = data + size;
+    return 0;
+}
+
+void ca_response_close_all(struct ca_parse_state* state) {
+    for (size_t i = 0; i < state->responses_length; i++) {
+        ca_response_release(state, &state->responses[i]);
+    }
+    state->responses_length = 0;
+    state->tokens = NULL;
+    state->tokens_end = NULL;
+}
@@ -0,0 +1,169 @@
+/**
+ * \file split.c
+ * \brief Shell-like splitting of response files and lines into arguments.
+ * \copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ * \author Ethan Uppal
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#define CA_PRIVATE_SRC
+#include "cmdapp.h"
+#undef CA_PRIVATE_SRC
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+    #define CA_SPLIT_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define CA_SPLIT_NEON
+#endif
+
+/** Whether `c` separates tokens. */
+static bool ca_split_is_space(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/** Whether `c` separates tokens or changes how the rest are read. */
+static bool ca_split_is_special(char c) {
+    return ca_split_is_space(c) || c == '\'' || c == '"' || c == '\\';
+}
+
+#if defined(CA_SPLIT_SSE2)
+
+/**
+ * Returns how many of the 16 bytes at `p` come before the first special one,
+ * or 16 if none is.
+ */
+static size_t ca_split_plain16(const char* p) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+
+    // whitespace other than ' ' is the range ['\t', '\r'], which is tested
+    // as an unsigned difference of at most four
+    __m128i offset = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i special = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(4)),
+        offset);
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+
+    unsigned mask = (unsigned)_mm_movemask_epi8(special);
+    if (mask == 0) {
+        return 16;
+    }
+    #if defined(__GNUC__)
+    return (size_t)__builtin_ctz(mask);
+    #else
+    size_t length = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        length++;
+    }
+    return length;
+    #endif
+}
+
+#elif defined(CA_SPLIT_NEON)
+
+/** See the SSE2 version above. */
+static size_t ca_split_plain16(const char* p) {
+    uint8x16_t v = vld1q_u8((const uint8_t*)p);
+    uint8x16_t special = vcleq_u8(vsubq_u8(v, vdupq_n_u8('\t')),
+        vdupq_n_u8(4));
+    special = vorrq_u8(special, vceqq_u8(v, vdupq_n_u8(' ')));
+    special = vorrq_u8(special, vceqq_u8(v, vdupq_n_u8('\'')));
+    special = vorrq_u8(special, vceqq_u8(v, vdupq_n_u8('"')));
+    special = vorrq_u8(special, vceqq_u8(v, vdupq_n_u8('\\')));
+    if (vmaxvq_u8(special) == 0) {
+        return 16;
+    }
+
+    // rare enough that finding the exact byte need not be fast
+    size_t length = 0;
+    while (!ca_split_is_special(p[length])) {
+        length++;
+    }
+    return length;
+}
+
+#endif
+
+/**
+ * Returns how many bytes in `[cur, end)` come before the first special one.
+ * Sixteen bytes are tested at a time where the target allows it.
+ */
+static size_t ca_split_plain(const char* cur, const char* end) {
+    size_t length = 0;
+#if defined(CA_SPLIT_SSE2) || defined(CA_SPLIT_NEON)
+    while ((size_t)(end - cur) - length >= 16) {
+        size_t plain = ca_split_plain16(cur + length);
+        length += plain;
+        if (plain < 16) {
+            return length;
+        }
+    }
+#endif
+    while (cur + length < end && !ca_split_is_special(cur[length])) {
+        length++;
+    }
+    return length;
+}
+
+char* ca_split_token(struct ca_parse_state* state) {
+    char* cur = state->tokens;
+    char* end = state->tokens_end;
+    while (cur < end && ca_split_is_space(*cur)) {
+        cur++;
+    }
+    if (cur == end) {
+        return NULL;
+    }
+
+    // quotes and escapes only ever shorten a token, so it is unquoted into
+    // the space it already occupies
+    char* token = cur;
+    char* out = cur;
+    char quote = '\0';
+    while (cur < end) {
+        // runs of ordinary bytes move as a block, and not at all until the
+        // first quote or escape
+        if (!quote) {
+            size_t plain = ca_split_plain(cur, end);
+            if (out != cur) {
+                memmove(out, cur, plain);
+            }
+            out += plain;
+            cur += plain;
+            if (cur == end) {
+                break;
+            }
+        }
+
+        char c = *cur++;
+        if (quote) {
+            if (c == quote) {
+                quote = '\0';
+                continue;
+            }
+            if (c == '\\' && quote == '"' && cur < end) {
+                c = *cur++;
+            }
+        } else if (ca_split_is_space(c)) {
+            break;
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            continue;
+        } else if (c == '\\' && cur < end) {
+            c = *cur++;
+        }
+        *out++ = c;
+    }
+
+    // `out` is at most at the separator just consumed, or at the spare byte
+    // at the end
+    *out = '\0';
+    state->tokens = cur;
+    return token;
+}
@@ -0,0 +1,46 @@
+/**
+ * \file stats.c
+ * \brief Access to the statistics of contexts and states.
+ * \copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ * \author Ethan Uppal
+ */
+
+// for clock_gettime()
+#define _POSIX_C_SOURCE 199309L
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define CA_PRIVATE_SRC
+#include "cmdapp.h"
+#undef CA_PRIVATE_SRC
+
+uint64_t ca_stats_now(void) {
+#if defined(CA_ON_UNIX)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#else
+    return (uint64_t)clock() * (1000000000u / CLOCKS_PER_SEC);
+#endif
+}
+
+const struct ca_stats* ca_ctx_get_stats(const struct ca_app* ctx) {
+#ifdef CA_STATS
+    return &ctx->schema.memory.stats;
+#else
+    (void)ctx;
+    return NULL;
+#endif
+}
+
+const struct ca_stats* ca_state_get_stats(
+    const struct ca_parse_state* state) {
+#ifdef CA_STATS
+    return &state->memory->stats;
+#else
+    (void)state;
+    return NULL;
+#endif
+}
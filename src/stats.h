@@ -0,0 +1,32 @@
+// Copyright (C) 2024 Ethan Uppal. All rights reserved.
+
+#pragma once
+
+#ifdef CA_PRIVATE_SRC
+
+    #ifdef CA_STATS
+
+        /**
+         * Adds `__n` to the counter `__field` of the statistics kept in
+         * `__mem`, a `struct ca_memory*`.
+         */
+        #define ca_stat_add(__mem, __field, __n)                               \
+            ((__mem)->stats.__field += (uint64_t)(__n))
+
+        /** Declares `__start` and starts timing a phase with it. */
+        #define ca_stat_begin(__start) uint64_t __start = ca_stats_now()
+
+        /** Adds the time since ca_stat_begin() of `__start` to `__field`. */
+        #define ca_stat_end(__mem, __field, __start)                           \
+            ((__mem)->stats.__field += ca_stats_now() - (__start))
+
+    #else
+
+        /** Statistics are not kept, so nothing is counted or timed. */
+        #define ca_stat_add(__mem, __field, __n) ((void)(__mem))
+        #define ca_stat_begin(__start) ((void)0)
+        #define ca_stat_end(__mem, __field, __start) ((void)(__mem))
+
+    #endif
+
+#endif
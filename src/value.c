@@ -0,0 +1,328 @@
+/**
+ * \file value.c
+ * \brief Conversion of arguments to the typed values of options.
+ * \copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ * \author Ethan Uppal
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <errno.h>
+
+#define CA_PRIVATE_SRC
+#include "cmdapp.h"
+#undef CA_PRIVATE_SRC
+
+/** The powers of ten a `double` holds exactly. */
+static const double ca_exact_powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+    1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+    1e19, 1e20, 1e21, 1e22};
+
+static bool ca_is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Reads the decimal digits at `*cur` into `*out`, advancing `*cur` past them.
+ * Returns zero on success, `EINVAL` if there are none, or `ERANGE` if they do
+ * not fit.
+ */
+static int ca_read_u64(const char** cur, const char* end, uint64_t* out) {
+    const char* p = *cur;
+    uint64_t n = 0;
+    bool overflow = false;
+    while (p < end && ca_is_digit(*p)) {
+        unsigned digit = (unsigned)(*p++ - '0');
+        if (n > (UINT64_MAX - digit) / 10) {
+            overflow = true;
+        }
+        n = n * 10 + digit;
+    }
+    if (p == *cur) {
+        return EINVAL;
+    }
+    *cur = p;
+    *out = n;
+    return overflow ? ERANGE : 0;
+}
+
+/**
+ * Reads a whole integer, with a sign only if `is_signed`, into a magnitude
+ * and sign. Returns as ca_read_u64().
+ */
+static int ca_read_integer(const char* arg, size_t length, bool is_signed,
+    uint64_t* magnitude, bool* negative) {
+    const char* cur = arg;
+    const char* end = arg + length;
+    *negative = false;
+    if (cur < end && (*cur == '+' || (is_signed && *cur == '-'))) {
+        *negative = *cur++ == '-';
+    }
+    int error = ca_read_u64(&cur, end, magnitude);
+    if (error == 0 && cur != end) {
+        return EINVAL;
+    }
+    return error;
+}
+
+static int ca_parse_int(const char* arg, size_t length, int* value) {
+    uint64_t magnitude;
+    bool negative;
+    int error = ca_read_integer(arg, length, true, &magnitude, &negative);
+    if (error != 0) {
+        return error;
+    }
+    if (negative) {
+        if (magnitude > (uint64_t)INT_MAX + 1) {
+            return ERANGE;
+        }
+        *value = magnitude == (uint64_t)INT_MAX + 1 ? INT_MIN
+                                                    : -(int)magnitude;
+    } else {
+        if (magnitude > INT_MAX) {
+            return ERANGE;
+        }
+        *value = (int)magnitude;
+    }
+    return 0;
+}
+
+static int ca_parse_u64(const char* arg, size_t length, uint64_t* value) {
+    bool negative;
+    return ca_read_integer(arg, length, false, value, &negative);
+}
+
+static int ca_parse_size(const char* arg, size_t length, size_t* value) {
+    // a binary suffix scales the number
+    unsigned shift = 0;
+    if (length > 0) {
+        switch (arg[length - 1]) {
+            case 'K':
+            case 'k':
+                shift = 10;
+                break;
+            case 'M':
+            case 'm':
+                shift = 20;
+                break;
+            case 'G':
+            case 'g':
+                shift = 30;
+                break;
+            case 'T':
+            case 't':
+                shift = 40;
+                break;
+        }
+    }
+    if (shift != 0) {
+        length--;
+    }
+
+    uint64_t n;
+    bool negative;
+    int error = ca_read_integer(arg, length, false, &n, &negative);
+    if (error != 0) {
+        return error;
+    }
+    if (n > (UINT64_MAX >> shift) || (n << shift) > SIZE_MAX) {
+        return ERANGE;
+    }
+    *value = (size_t)(n << shift);
+    return 0;
+}
+
+// the most significant digits that can decide how a decimal rounds to a
+// `double`; past them, only whether any digit is nonzero matters
+#define CA_MAX_DOUBLE_DIGITS 800
+
+/**
+ * Converts with `strtod`, for numbers the fast path cannot round exactly.
+ * The number, which the fast path has checked, is rewritten as `0.DIGITS`
+ * times a power of ten in the current locale. Digits past
+ * `CA_MAX_DOUBLE_DIGITS` are cut, leaving a `1` in their place if any was
+ * nonzero, so that an argument of any length fits the buffer.
+ */
+static int ca_parse_double_slow(const char* arg, size_t length,
+    double* value) {
+    const char* point = localeconv()->decimal_point;
+    size_t point_length = strlen(point);
+
+    // a sign, `0`, a point of up to 16 bytes, the digits, one in place of
+    // those cut, and an exponent
+    char buffer[CA_MAX_DOUBLE_DIGITS + 64];
+    if (point_length > 16) {
+        return EINVAL;
+    }
+    const char* cur = arg;
+    const char* end = arg + length;
+    size_t used = 0;
+    if (cur < end && (*cur == '+' || *cur == '-')) {
+        if (*cur++ == '-') {
+            buffer[used++] = '-';
+        }
+    }
+    buffer[used++] = '0';
+    memcpy(buffer + used, point, point_length);
+    used += point_length;
+
+    // leading zeros only move the point, and each digit before it moves it
+    // one place right
+    size_t digits = 0;
+    bool cut = false;
+    bool seen_point = false;
+    long exponent = 0;
+    for (; cur < end && *cur != 'e' && *cur != 'E'; cur++) {
+        if (*cur == '.') {
+            seen_point = true;
+            continue;
+        }
+        if (digits == 0 && *cur == '0') {
+            exponent -= seen_point;
+            continue;
+        }
+        exponent += !seen_point;
+        if (digits < CA_MAX_DOUBLE_DIGITS) {
+            buffer[used + digits++] = *cur;
+        } else if (*cur != '0') {
+            cut = true;
+        }
+    }
+    if (digits == 0) {
+        buffer[used + digits++] = '0';
+    } else if (cut) {
+        buffer[used + digits++] = '1';
+    }
+    used += digits;
+
+    if (cur < end) {
+        cur++;
+        bool negative_exponent = false;
+        if (cur < end && (*cur == '+' || *cur == '-')) {
+            negative_exponent = *cur++ == '-';
+        }
+        uint64_t written;
+        // past this, the result is zero or infinite anyway
+        if (ca_read_u64(&cur, end, &written) != 0 || written > 100000) {
+            written = 100000;
+        }
+        exponent += negative_exponent ? -(long)written : (long)written;
+    }
+    snprintf(buffer + used, sizeof(buffer) - used, "e%ld", exponent);
+
+    errno = 0;
+    double result = strtod(buffer, NULL);
+    if (errno == ERANGE && (result == HUGE_VAL || result == -HUGE_VAL)) {
+        return ERANGE;
+    }
+    *value = result;
+    return 0;
+}
+
+static int ca_parse_double(const char* arg, size_t length, double* value) {
+    const char* cur = arg;
+    const char* end = arg + length;
+    bool negative = false;
+    if (cur < end && (*cur == '+' || *cur == '-')) {
+        negative = *cur++ == '-';
+    }
+
+    // keep the first 19 significant digits, which always fit, and track the
+    // decimal exponent of the last one kept
+    uint64_t mantissa = 0;
+    int digits = 0;
+    long exponent = 0;
+    bool any = false;
+    bool seen_point = false;
+    for (; cur < end; cur++) {
+        if (*cur == '.' && !seen_point) {
+            seen_point = true;
+            continue;
+        }
+        if (!ca_is_digit(*cur)) {
+            break;
+        }
+        any = true;
+        if (mantissa == 0 && *cur == '0') {
+            exponent -= seen_point;
+        } else if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*cur - '0');
+            digits++;
+            exponent -= seen_point;
+        } else {
+            exponent += !seen_point;
+        }
+    }
+    if (!any) {
+        return EINVAL;
+    }
+    if (cur < end && (*cur == 'e' || *cur == 'E')) {
+        cur++;
+        bool negative_exponent = false;
+        if (cur < end && (*cur == '+' || *cur == '-')) {
+            negative_exponent = *cur++ == '-';
+        }
+        uint64_t written;
+        int error = ca_read_u64(&cur, end, &written);
+        if (error == EINVAL) {
+            return EINVAL;
+        }
+        // past this, the result is zero or infinite anyway
+        if (error == ERANGE || written > 100000) {
+            written = 100000;
+        }
+        exponent += negative_exponent ? -(long)written : (long)written;
+    }
+    if (cur != end) {
+        return EINVAL;
+    }
+
+    // both the mantissa and the power of ten are exact, so one operation
+    // rounds correctly; otherwise leave it to the C library
+    if (mantissa <= (UINT64_C(1) << 53) && exponent >= -22
+        && exponent <= 22) {
+        double result = (double)mantissa;
+        if (exponent < 0) {
+            result /= ca_exact_powers[-exponent];
+        } else {
+            result *= ca_exact_powers[exponent];
+        }
+        *value = negative ? -result : result;
+        return 0;
+    }
+    return ca_parse_double_slow(arg, length, value);
+}
+
+int ca_parse_value(enum ca_value_type type, const char* arg, size_t length,
+    void* value) {
+    int error = EINVAL;
+    switch (type) {
+        case CA_VALUE_STRING:
+            *(const char**)value = arg;
+            error = 0;
+            break;
+        case CA_VALUE_INT:
+            error = ca_parse_int(arg, length, value);
+            break;
+        case CA_VALUE_U64:
+            error = ca_parse_u64(arg, length, value);
+            break;
+        case CA_VALUE_DOUBLE:
+            error = ca_parse_double(arg, length, value);
+            break;
+        case CA_VALUE_SIZE:
+            error = ca_parse_size(arg, length, value);
+            break;
+    }
+    if (error != 0) {
+        errno = error;
+        return 1;
+    }
+    return 0;
+}
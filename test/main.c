@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <cmdapp.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 struct app {
@@ -20,6 +21,95 @@ void arg_callback(const char* arg, void* data) {
     printf("arg: arg=%s\n", arg);
 }
 
+void d_handler(const char* arg, void* data) {
+    printf("handler: -d\n");
+}
+
+// the handles of the options register_run() registers
+enum { RUN_FAST, RUN_SLOW, RUN_HELP };
+
+void register_run(struct ca_app* ctx, void* data) {
+    ca_ctx_description(ctx, "Runs the example.");
+    ca_ctx_synopsis(ctx, "run [OPTION]... [ARG]...");
+    ca_ctx_opt(ctx, 'f', "fast", "*", NULL, "multiflag");
+    ca_ctx_opt(ctx, 's', "slow", "!@f", NULL, "incompatible with -f");
+    ca_ctx_opt(ctx, 'h', "help", "<h", NULL, "prints this info");
+    ca_ctx_set_callbacks(ctx, opt_callback, arg_callback);
+}
+
+// reads all of `path` into a new buffer, storing its size in `length`
+char* read_file(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    char* buffer = NULL;
+    size_t size = 0;
+    char chunk[256];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        char* grown = realloc(buffer, size + read);
+        if (!grown) {
+            free(buffer);
+            fclose(file);
+            return NULL;
+        }
+        buffer = grown;
+        memcpy(buffer + size, chunk, read);
+        size += read;
+    }
+    fclose(file);
+    *length = size;
+    return buffer ? buffer : malloc(1);
+}
+
+// parses the command line against the run subcommand's options, saved to a
+// blob and loaded back as a program sharing the schema would
+int parse_with_blob(int argc, const char* argv[]) {
+    struct ca_app* ctx = ca_ctx_new(argc, argv);
+    if (!ctx) {
+        perror("ca_ctx_new");
+        return 1;
+    }
+    register_run(ctx, NULL);
+    const struct ca_schema* schema = ca_ctx_schema(ctx);
+    size_t size = schema ? ca_schema_serialize(schema, NULL, 0) : 0;
+    void* blob = size ? malloc(size) : NULL;
+    if (!blob || ca_schema_serialize(schema, blob, size) != size) {
+        perror("ca_schema_serialize");
+        free(blob);
+        ca_ctx_free(ctx);
+        return 1;
+    }
+    ca_ctx_free(ctx);
+
+    // the blob is all that is left of the context
+    int status = 1;
+    const struct ca_schema* loaded = ca_schema_load(blob, size);
+    struct ca_parse_state* state = loaded ? ca_state_new(loaded) : NULL;
+    if (!state) {
+        perror("ca_schema_load");
+    } else if (getenv("MAIN_BATCH")) {
+        // parse it alongside a conflicting line, on two threads
+        const char* conflicting[] = {argv[0], "-f", "-s"};
+        struct ca_batch_item items[] = {{argc, argv}, {3, conflicting}};
+        enum ca_error results[2];
+        if (ca_parse_batch(loaded, items, 2, results, 2) == 0) {
+            printf("batch: %d %d\n", (int)results[0], (int)results[1]);
+            status = 0;
+        }
+    } else {
+        // a failed parse reports nothing as passed
+        status = ca_state_parse(state, argc, argv, NULL) != 0;
+        printf("blob: fast=%d slow=%d\n", ca_state_was_passed(state, RUN_FAST),
+            ca_state_was_passed(state, RUN_SLOW));
+    }
+    ca_state_free(state);
+    ca_schema_free(loaded);
+    free(blob);
+    return status;
+}
+
 int main(int argc, const char* argv[]) {
     struct app* app = malloc(sizeof(*app));
     if (!app) {
@@ -27,6 +117,11 @@ int main(int argc, const char* argv[]) {
         return 1;
     }
 
+    if (getenv("MAIN_BLOB")) {
+        free(app);
+        return parse_with_blob(argc, argv);
+    }
+
     if (ca_init(argc, argv) != 0) {
         perror("ca_init");
         return 1;
@@ -43,26 +138,119 @@ int main(int argc, const char* argv[]) {
     // program usage
     ca_synopsis("subcommand [OPTION]...");
     ca_synopsis("[OPTION]... FILE");
+    ca_use_response_files(true);
+    ca_use_man_option(true);
+    ca_use_complete_option(true);
+    ca_env_prefix("MAIN_");
+    ca_config_file(getenv("MAIN_CONFIG"));
 
     // prorgam options
     const char* a_arg = NULL;
-    bool* a = ca_opt('a', "aa", ".LOL", &a_arg, "required arg");
-    bool* A = ca_opt('A', "aa", ".?", &a_arg, "optional arg");
-    bool* b = ca_opt('b', "bb", "*", NULL, "multiflag");
-    bool* c = ca_opt('c', "cc", "*", NULL, "multiflag");
-    bool* d = ca_opt('d', "dd", "!@bc", NULL, "incompatible with -b and -c");
-    bool* O = ca_opt('O', "opt", "&ad", NULL, "depends on a and d");
+    int a = ca_opt('a', "aa", ".LOL", &a_arg, "required arg");
+    int A = ca_opt('A', "optArg", ".?", &a_arg, "optional arg");
+    int b = ca_opt('b', "bb", "*", NULL, "multiflag");
+    int c = ca_opt('c', "cc", "*", NULL, "multiflag");
+    int d = ca_opt('d', "dd", "!@bc", NULL, "incompatible with -b and -c");
+    int O = ca_opt('O', "opt", "&ad", NULL, "depends on a and d");
+    const char* include = NULL;
+    int I = ca_opt('I', "include", ".DIR+", &include, "repeatable arg");
+    int jobs = 1;
+    ca_opt_int('j', "jobs", ".N", &jobs, "integer arg");
+    double ratio = 1;
+    ca_opt_double('r', "ratio", ".X", &ratio, "double arg");
+
+    // options registered as one table
+    const char* width = NULL;
+#define TABLE_OPTIONS(X)                                       \
+    X(OPT_WIDTH, 'w', "width", ".N", &width, "table arg")      \
+    X(OPT_NARROW, 'n', "narrow", "*", NULL, "table multiflag")
+    const struct ca_opt_spec specs[] = {TABLE_OPTIONS(CA_OPT_SPEC)};
+    enum { TABLE_OPTIONS(CA_OPT_HANDLE) };
+    int table = ca_opts(specs, sizeof(specs) / sizeof(*specs));
+    assert(table >= 0);
 
     ca_opt('h', "help", "<h", NULL, "prints this info");
     ca_opt('v', "version", "<v", NULL, "prints version info");
 
+    ca_subcommand("run", "runs the example", register_run, NULL);
+
     // parse
     ca_set_callbacks(opt_callback, arg_callback);
-    if (ca_parse(app) != 0) {
+    ca_set_handler(d, d_handler, NULL);
+
+    // parse one item at a time if asked to, printing each
+    if (getenv("MAIN_ITER")) {
+        if (ca_iter_begin() != 0) {
+            return 1;
+        }
+        struct ca_item item;
+        while (ca_next(&item)) {
+            if (item.handle < 0) {
+                printf("item: arg=%s\n", item.arg);
+            } else {
+                printf("item: short_opt=%c long_opt=%s arg=%.*s\n",
+                    item.short_opt, item.long_opt,
+                    item.arg ? (int)item.arg_length : 6,
+                    item.arg ? item.arg : "(null)");
+            }
+        }
+        return ca_iter_finish() != 0;
+    }
+
+    // report every error at once if asked to, instead of only the first
+    struct ca_diagnostic diagnostics[8];
+    if (getenv("MAIN_DIAGNOSTICS")) {
+        ca_collect_diagnostics(diagnostics, 8);
+    }
+    // parse a line from a file instead of the command line if asked to
+    int status;
+    const char* line_file = getenv("MAIN_LINE_FILE");
+    if (line_file) {
+        size_t length;
+        char* line = read_file(line_file, &length);
+        if (!line) {
+            perror(line_file);
+            return 1;
+        }
+        status = ca_parse_line(line, length, app);
+        free(line);
+    } else {
+        status = ca_parse(app);
+    }
+    if (status != 0) {
+        size_t count = ca_diagnostic_count();
+        for (size_t i = 0; i < count && i < 8; i++) {
+            printf("diagnostic: code=%d opt=%d arg_index=%d\n",
+                (int)diagnostics[i].code, diagnostics[i].opt,
+                diagnostics[i].arg_index);
+        }
         return 1;
     }
 
-    printf("a was passed: %s (arg was %s)\n", (*a) ? "true" : "false", a_arg);
+    printf("a was passed: %s (arg was %s)\n",
+        ca_was_passed(a) ? "true" : "false", ca_arg(a));
+
+    size_t include_count;
+    const char* const* includes = ca_values(I, &include_count);
+    for (size_t i = 0; i < include_count; i++) {
+        printf("include: %s\n", includes[i]);
+    }
+    printf("jobs: %d\n", jobs);
+    printf("ratio: %.17g\n", ratio);
+    printf("table: width=%s narrow=%s\n", ca_arg(table + OPT_WIDTH),
+        ca_was_passed(table + OPT_NARROW) ? "true" : "false");
+
+    // parse a different command line over this one if asked to
+    if (getenv("MAIN_REPARSE")) {
+        const char* again[] = {argv[0], "-c"};
+        if (ca_reparse(2, again, app) != 0) {
+            return 1;
+        }
+        ca_values(I, &include_count);
+        printf("reparse: b=%s c=%s includes=%zu\n",
+            ca_was_passed(b) ? "true" : "false",
+            ca_was_passed(c) ? "true" : "false", include_count);
+    }
 
     free(app);
 }